@@ -33,6 +33,7 @@ extern "C" {
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <sys/uio.h>
 
 #include <sodium.h>
 
@@ -55,6 +56,7 @@ trip_global_destroy(void);
 #define TRIP_SIGN_SEC (crypto_sign_SECRETKEYBYTES)
 #define TRIP_KEY_PUB (crypto_box_PUBLICKEYBYTES)
 #define TRIP_KEY_SEC (crypto_box_SECRETKEYBYTES)
+#define TRIP_KEY_TICKET (crypto_secretbox_KEYBYTES)
 #define trip_sign_kp crypto_sign_keypair
 #define trip_kp crypto_box_keypair
 
@@ -89,6 +91,11 @@ typedef struct trip_screen_s
 typedef void trip_handle_screen_t(trip_router_t *r, trip_screen_t *);
 typedef void trip_handle_connection_t(trip_connection_t *);
 typedef void trip_handle_stream_t(trip_stream_t *);
+/* Called before a handle is freed to hibernate (true), and with the new
+ * handle on waking (false). A wake for a segment that is then rejected
+ * hibernates again straight away.
+ */
+typedef void trip_handle_hibernate_t(trip_connection_t *, bool);
 enum trip_message_status
 {
     /* Receiving message. */
@@ -100,6 +107,7 @@ enum trip_message_status
     TRIPM_KILL,
 };
 typedef void trip_handle_message_t(trip_stream_t *, enum trip_message_status, size_t, unsigned char *);
+typedef void trip_handle_release_t(trip_stream_t *, enum trip_message_status, void *);
 
 enum trip_preset
 {
@@ -125,6 +133,16 @@ enum trip_router_opt
     TRIPOPT_ALLOW_PLAIN_ISIG, /* Incoming unsigned packets. */
     TRIPOPT_ALLOW_PLAIN_OSIG, /* Outgoing unsigned packets. */
     TRIPOPT_ALLOW_PLAIN_COMM,
+    TRIPOPT_WRITABLE_CB, /* Stream may send again after EWOULDBLOCK. */
+    TRIPOPT_STREAM_WATERMARK, /* (size_t low, size_t high) queued bytes. */
+    TRIPOPT_RECV_LOAN, /* Received buffers are kept until trip_release. */
+    TRIPOPT_HIBERNATE, /* (int ms, trip_handle_hibernate_t *) idle; zero disables. */
+    TRIPOPT_TICKET, /* (int ms, unsigned char *key) lifetime; NULL key random. ENOTSUP until segments are sealed. */
+    TRIPOPT_RENEW, /* (uint64_t bytes, uint64_t packets, int overlapms) zero never. */
+    TRIPOPT_PMTU, /* (size_t base, size_t max) segment sizes; discovery if max > base. */
+    TRIPOPT_KEEPALIVE, /* (int ms) idle time before a PING is sent. */
+    TRIPOPT_RUN_EDGE, /* (int bool) trip_run watches edge-triggered. */
+    TRIPOPT_RUN_BUSY_POLL, /* (int us, int bool) spin after activity; SO_BUSY_POLL. */
 };
 
 trip_router_t *
@@ -137,6 +155,8 @@ trip_setopt(trip_router_t *r, enum trip_router_opt opt, ...);
 
 const char *
 trip_errmsg(trip_router_t *_r);
+void
+trip_release(trip_router_t *r, unsigned char *buf);
 
 int
 trip_timeout(trip_router_t *);
@@ -156,6 +176,14 @@ trip_stop(trip_router_t *r);
 
 void
 trip_open_connection(trip_router_t *r, void *ud, size_t ilen, unsigned char *info);
+trip_connection_t *
+trip_restore_connection(trip_router_t *r, void *ud, size_t len, const unsigned char *buf);
+trip_connection_t *
+trip_resume_connection(trip_router_t *r, void *ud, size_t len, const unsigned char *buf);
+int
+trip_snapshot(trip_router_t *r, const char *path);
+int
+trip_restore(trip_router_t *r, const char *path);
 
 
 /* TRiP Connection Interface */
@@ -176,12 +204,23 @@ enum trip_connection_status
 tripc_status(trip_connection_t *c);
 void
 tripc_close(trip_connection_t *c, int gracems);
-#define TRIPS_OPT_PRIORITY (1 << 0)
+#define TRIPC_MAX_WEIGHT (1 << 16)
+int
+tripc_set_weight(trip_connection_t *c, uint32_t weight);
+size_t
+tripc_umtu(trip_connection_t *c);
+int
+tripc_renew(trip_connection_t *c);
 #define TRIPS_OPT_CHUNK    (1 << 1)
 #define TRIPS_OPT_ORDERED  (1 << 2)
 #define TRIPS_OPT_RELIABLE (1 << 3)
+#define TRIPS_OPT_LATEST   (1 << 4) /* Unreliable, new sends replace queued. */
+/* Stream priority, zero is sent first. */
+#define TRIPS_PRIORITY_LEVELS (8)
 trip_stream_t *
-tripc_open_stream(trip_connection_t *c, int sid, int options);
+tripc_open_stream(trip_connection_t *c, int sid, int priority, int options);
+size_t
+tripc_serialize(trip_connection_t *c, size_t cap, unsigned char *buf);
 int
 tripc_get_errno(trip_connection_t *c);
 const char *
@@ -203,16 +242,41 @@ enum trip_stream_status
     TRIPS_STATUSO_ERROR  = 7,
 };
 
+/* Names a stream by value so another thread may send to it without
+ * holding the handle; sends to a stream that has since closed fail.
+ */
+typedef struct trip_streamref_s
+{
+    trip_router_t *router;
+    uint64_t connid;
+    uint64_t gen;
+    int streamid;
+} trip_streamref_t;
+
 int
 trips_id(trip_stream_t *s);
 enum trip_stream_status
 trips_status(trip_stream_t *s);
 int
+trips_priority(trip_stream_t *s);
+int
 trips_type(trip_stream_t *s);
 void
 trips_close(trip_stream_t *s);
 int
 trips_send(trip_stream_t *s, size_t, const unsigned char *);
+int
+trips_sendv(trip_stream_t *s, const struct iovec *iov, int iovcnt,
+            trip_handle_release_t *release, void *ctx);
+trip_streamref_t
+trips_ref(trip_stream_t *s);
+int
+trips_send_ref(const trip_streamref_t *ref, size_t, const unsigned char *);
+int
+trips_sendv_ref(const trip_streamref_t *ref, const struct iovec *iov, int iovcnt,
+                trip_handle_release_t *release, void *ctx);
+int
+trips_set_fec(trip_stream_t *s, int k);
 
 
 #ifdef __cplusplus
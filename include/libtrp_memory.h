@@ -35,6 +35,7 @@ extern "C" {
 #define tripm_alloc malloc
 #define tripm_realloc realloc
 #define tripm_free free
+#define tripm_memalign posix_memalign
 
 #ifdef __cplusplus
 }
@@ -44,6 +44,9 @@ typedef void triptimer_cb_t(void *data);
 void
 trip_seg(trip_router_t *r, int src, size_t len, void *buf);
 void
+trip_seg_batch(trip_router_t *r, int n, const int *srcs, const size_t *lens,
+               void *const *bufs);
+void
 trip_ready(trip_router_t *r);
 void
 trip_resolve(trip_router_t *r, int rkey, int src, int err, const char *emsg);
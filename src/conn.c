@@ -34,6 +34,7 @@
 #include "protocol.h"
 #include "resolveq.h"
 #include "stream.h"
+#include "ticket.h"
 #include "time.h"
 #include "trip.h"
 #include "util.h"
@@ -77,12 +78,12 @@ _tripc_set_error(_trip_connection_t *c, int eval, const char *msg)
     if (_TRIPC_STATE_ERROR != c->state)
     {
         size_t mlen = strlen(msg ? msg : "");
-        c->error = eval;
-        c->errmsg = tripm_alloc(mlen + 1);
-        if (c->errmsg)
+        c->cold->error = eval;
+        c->cold->errmsg = tripm_alloc(mlen + 1);
+        if (c->cold->errmsg)
         {
-            memcpy(c->errmsg, msg, mlen);
-            c->errmsg[mlen] = 0;
+            memcpy(c->cold->errmsg, msg, mlen);
+            c->cold->errmsg[mlen] = 0;
         }
         _tripc_set_state(c, _TRIPC_STATE_ERROR);
     }
@@ -91,12 +92,113 @@ _tripc_set_error(_trip_connection_t *c, int eval, const char *msg)
 void
 _tripc_set_screen(_trip_connection_t *c, trip_screen_t *screen)
 {
-    c->data = screen->data;
-    c->rlen = screen->routelen;
-    c->route = tripm_bdup(c->rlen, screen->route);
-    c->self.opensk = screen->opensk;
-    c->peer.signpk = screen->signpk;
-    c->self.signsk = screen->signsk;
+    c->cold->data = screen->data;
+    c->cold->rlen = screen->routelen;
+    c->cold->route = tripm_bdup(c->cold->rlen, screen->route);
+    c->cold->self.opensk = screen->opensk;
+    c->cold->peer.signpk = screen->signpk;
+    c->cold->self.signsk = screen->signsk;
+}
+
+static bool
+_tripc_is_inline_stream(_trip_connection_t *c, _trip_stream_t *s)
+{
+    return s >= c->inlinestreams && s < c->inlinestreams + _TRIPC_INLINE_STREAMS;
+}
+
+/**
+ * Low IDs use the connection's inline storage; the map guarantees that
+ * slot is unused since IDs are unique.
+ * @return NULL if the ID is taken, over the limit, or out of memory.
+ */
+static _trip_stream_t *
+_tripc_new_stream(_trip_connection_t *c, int sid, int priority, int options)
+{
+    _trip_stream_t *s = NULL;
+
+    if (sid >= 0 && sid < _TRIPC_INLINE_STREAMS)
+    {
+        if (streammap_get(&c->streams, sid))
+        {
+            return NULL;
+        }
+
+        s = &c->inlinestreams[sid];
+    }
+    else
+    {
+        s = tripm_alloc(sizeof(_trip_stream_t));
+
+        if (!s)
+        {
+            return NULL;
+        }
+    }
+
+    _trips_init(s, c, sid, priority, options);
+
+    if (streammap_add(&c->streams, s))
+    {
+        if (!_tripc_is_inline_stream(c, s))
+        {
+            tripm_free(s);
+        }
+
+        return NULL;
+    }
+
+    return s;
+}
+
+/**
+ * Remove the stream from the map and release its memory.
+ */
+static void
+_tripc_free_stream(_trip_connection_t *c, _trip_stream_t *s)
+{
+    streammap_del(&c->streams, s->id);
+    messageq_del_stream(&c->msg, s);
+    _trips_destroy(s);
+
+    if (_tripc_is_inline_stream(c, s))
+    {
+        memset(s, 0, sizeof(*s));
+    }
+    else
+    {
+        tripm_free(s);
+    }
+}
+
+/**
+ * Look up the stream for an incoming DATA frame.
+ * Streams are created on the fly, the first frame opens it.
+ * @return NULL if the stream cannot be created.
+ */
+_trip_stream_t *
+_tripc_get_stream(_trip_connection_t *c, int sid)
+{
+    _trip_stream_t *s = streammap_get(&c->streams, sid);
+
+    if (LIKELY(s))
+    {
+        return s;
+    }
+
+    /* The map allows up to the peer's limit; theirs are bounded by ours. */
+    if (sid < 0 || (uint32_t)sid >= c->cold->self.lim.stream)
+    {
+        return NULL;
+    }
+
+    s = _tripc_new_stream(c, sid, _TRIPS_DEFAULT_PRIORITY, 0);
+
+    if (s && c->router->stream)
+    {
+        c->router->stream((trip_stream_t *)s);
+    }
+
+    return s;
 }
 
 void
@@ -149,29 +251,39 @@ _tripc_mk_keys(_trip_connection_t *c)
             break;
         }
 
-        if (!c->self.pk)
+        if (!c->cold->self.pk)
         {
-            c->self.pk = tripm_alloc(TRIP_KEY_PUB);
+            c->cold->self.pk = tripm_alloc(TRIP_KEY_PUB);
         }
 
-        if (!c->self.sk)
+        if (!c->cold->self.sk)
         {
-            c->self.sk = tripm_alloc(TRIP_KEY_SEC);
+            c->cold->self.sk = tripm_alloc(TRIP_KEY_SEC);
         }
 
-        if (!c->self.pk || !c->self.sk)
+        if (!c->cold->self.pk || !c->cold->self.sk)
         {
             error = ENOMEM;
             break;
         }
 
-        trip_kp(c->self.pk, c->self.sk);
+        trip_kp(c->cold->self.pk, c->cold->self.sk);
     } while (false);
 
     if (error)
     {
-        c->self.pk = tripm_cfree(c->self.pk);
-        c->self.sk = tripm_cfree(c->self.sk);
+        c->cold->self.pk = tripm_cfree(c->cold->self.pk);
+        c->cold->self.sk = tripm_cfree(c->cold->self.sk);
+    }
+}
+
+static void
+_tripc_wipe_key(unsigned char **key, size_t len)
+{
+    if (*key)
+    {
+        sodium_memzero(*key, len);
+        *key = tripm_cfree(*key);
     }
 }
 
@@ -180,6 +292,7 @@ _tripc_generate_ping(_trip_connection_t *c)
 {
     _trip_nonce_init(c->ping.nonce);
     c->ping.timestamp = triptime_now();
+    c->ping.tries = 0;
 }
 
 int
@@ -200,9 +313,9 @@ _tripc_timeout_state_resolve_cb(void *_c)
 #endif
     
     /* Cleanup resolve entry. */
-    resolveq_del(&c->router->resolveq, c->resolvekey);
+    resolveq_del(&c->router->resolveq, c->cold->resolvekey);
     /* Clear timer ref. */
-    c->statetimer = NULL;
+    c->cold->statetimer = NULL;
     /* Set error and destroy. */
     _tripc_set_error(c, ETIME, NULL);
     _trip_close_connection(c->router, c);
@@ -214,7 +327,7 @@ _tripc_timeout_state_resend_cb(void *_c)
     trip_toconn(c, _c);
 
     uint64_t now = triptime_now();
-    if (now > c->statedeadline)
+    if (now > c->cold->statedeadline)
     {
         _tripc_set_error(c, ETIME, NULL);
         _trip_close_connection(c->router, c);
@@ -222,16 +335,58 @@ _tripc_timeout_state_resend_cb(void *_c)
     }
     else
     {
+        /* RFC 6298 5.5; the backed off RTO stays until a new sample. */
+        rtt_backoff(&c->rtt);
         _tripc_set_send(c);
         _tripc_set_timeout(c, _tripc_get_growth(c), _tripc_timeout_state_resend_cb);
     }
 }
 
+/**
+ * RESUME is resent until anything comes back. The server stays silent on
+ * a ticket it rejects, so past the state deadline we do a full handshake.
+ */
+void
+_tripc_timeout_resume_cb(void *_c)
+{
+    trip_toconn(c, _c);
+
+    if (!c->resuming)
+    {
+        return;
+    }
+
+    if (triptime_now() > c->cold->statedeadline)
+    {
+        _tripc_reopen(c);
+        return;
+    }
+
+    rtt_backoff(&c->rtt);
+    _tripc_set_send(c);
+    _tripc_set_timeout(c, _tripc_get_growth(c), _tripc_timeout_resume_cb);
+}
+
+/**
+ * Hibernation is checked on the same schedule, so whichever is sooner.
+ */
+static int
+_tripc_keepalive_ms(_trip_connection_t *c)
+{
+    _trip_router_t *r = c->router;
+
+    if (r->hibernatems && r->hibernatems < r->keepalivems)
+    {
+        return r->hibernatems;
+    }
+
+    return r->keepalivems;
+}
+
 void
 _tripc_timeout_state_ready_ping(void *_c)
 {
     trip_toconn(c, _c);
-
     _tripc_set_state(c, _TRIPC_STATE_PING);
 }
 
@@ -241,48 +396,48 @@ _tripc_timeout_state_ready_ping(void *_c)
 void
 _tripc_set_deadline(_trip_connection_t *c, int ms)
 {
-    c->statedeadline = triptime_deadline(ms);
+    c->cold->statedeadline = triptime_deadline(ms);
 }
 
 void
 _tripc_set_growth(_trip_connection_t *c, int ms)
 {
-    c->growms = ms;
-    c->retry = 0;
+    c->cold->growms = ms;
+    c->cold->retry = 0;
 }
 
 int
 _tripc_get_growth(_trip_connection_t *c)
 {
-    int curr = c->growms;
-    c->growms += c->growms / 2;
-    if (c->growms > c->maxstatems)
+    int curr = c->cold->growms;
+    c->cold->growms *= 2;
+    if (c->cold->growms > _RTT_MAX_RTO)
     {
-        c->growms = c->maxstatems;
+        c->cold->growms = _RTT_MAX_RTO;
     }
-    ++c->retry;
+    ++c->cold->retry;
     return curr;
 }
 
 bool
 _tripc_done_retry(_trip_connection_t *c)
 {
-    return c->maxretry > 0 && c->retry > c->maxretry;
+    return c->cold->maxretry > 0 && c->cold->retry > c->cold->maxretry;
 }
 
 void
 _tripc_set_timeout(_trip_connection_t *c, int ms, timer_cb_t *cb)
 {
-    c->statetimer = trip_set_timeout((trip_router_t *)c->router, ms, c, cb);
+    c->cold->statetimer = trip_set_timeout((trip_router_t *)c->router, ms, c, cb);
 }
 
 void
 _tripc_cancel_timeout(_trip_connection_t *c)
 {
-    if (c->statetimer)
+    if (c->cold->statetimer)
     {
-        _trip_cancel_timeout(c->statetimer);
-        c->statetimer = NULL;
+        _trip_cancel_timeout(c->cold->statetimer);
+        c->cold->statetimer = NULL;
     }
 }
 
@@ -303,7 +458,22 @@ _tripc_clear_send(_trip_connection_t *c)
 uint64_t
 _tripc_seq(_trip_connection_t *c)
 {
-    return c->self.sequence++;
+    uint64_t mark = c->cold->seqmark;
+
+    if (UNLIKELY(mark && c->sequence + _TRIPR_SNAPSHOT_EARLY >= mark))
+    {
+        if (c->sequence >= mark)
+        {
+            /* Used up before the timer ran; move it before this is used. */
+            _trip_snapshot_extend(c->router);
+        }
+        else
+        {
+            _trip_snapshot_due(c->router);
+        }
+    }
+
+    return c->sequence++;
 }
 
 size_t
@@ -348,28 +518,28 @@ _tripc_send_open(_trip_connection_t *c, size_t blen, void *buf)
     printf("%s: packlen(%lu)\n", __func__, trip_pack_len(FMT));
 #endif
 
-    uint8_t eflag = c->peer.openpk ? _TRIP_PREFIX_EMASK : 0;
+    uint8_t eflag = c->cold->peer.openpk ? _TRIP_PREFIX_EMASK : 0;
 
     size_t len = trip_pack(blen, buf, FMT,
         (uint8_t)(_TRIP_CONTROL_OPEN | eflag),
-        c->self.id,
+        c->id,
         _tripc_seq(c),
 
         (uint16_t)TRIP_VERSION_MAJOR,
         (uint32_t)0,
         (unsigned char *)NULL,
 
-        c->peer.openpk,
+        c->cold->peer.openpk,
 
-        c->self.id,
-        c->self.nonce,
-        c->self.pk,
+        c->id,
+        c->cold->self.nonce,
+        c->cold->self.pk,
         (uint32_t)128000,
-        (uint32_t)8,
+        c->cold->self.lim.stream,
         (uint32_t)65536,
         (uint32_t)128,
 
-        c->self.signsk
+        c->cold->self.signsk
         );
 #if DEBUG_CONNECTION
     printf("OPEN:\n");
@@ -385,27 +555,27 @@ _tripc_send_chal(_trip_connection_t *c, size_t blen, void *buf)
 {
     static const char FMT[] =   "sCQWoQnkIIIIOS";
 
-    uint8_t eflag = c->peer.pk ? _TRIP_PREFIX_EMASK : 0;
+    uint8_t eflag = c->cold->peer.pk ? _TRIP_PREFIX_EMASK : 0;
 
     size_t len = trip_pack(blen, buf, FMT,
         (uint8_t)(_TRIP_CONTROL_CHAL | eflag),
-        c->peer.id,
+        c->peerid,
         _tripc_seq(c),
 
-        c->peer.openpk,
+        c->cold->peer.openpk,
 
-        c->self.id,
-        c->self.nonce,
-        c->self.pk,
+        c->id,
+        c->cold->self.nonce,
+        c->cold->self.pk,
         (uint32_t)128000,
-        (uint32_t)8,
+        c->cold->self.lim.stream,
         (uint32_t)65536,
         (uint32_t)128,
 
-        c->self.signsk
+        c->cold->self.signsk
         );
 #if DEBUG_CONNECTION
-    printf("CHAL %lx:\n", c->peer.id);
+    printf("CHAL %lx:\n", c->peerid);
     trip_dump(len, buf);
     printf("\n");
 #endif
@@ -430,37 +600,65 @@ _tripc_prep_nonce(unsigned char *out, unsigned char *nonce, uint8_t control, uin
     return NULL;
 }
 
+/**
+ * @param kind - _TRIP_PING_REQUEST, or _TRIP_PING_REPLY for an echo.
+ * @param delay - How long the PING being echoed was held; zero otherwise.
+ */
+static size_t
+_tripc_pack_ping(_trip_connection_t *c, size_t blen, void *buf, uint8_t kind,
+                 const unsigned char *random, uint32_t delay)
+{
+    static const char FMT[] =   "CQWeCnQIIIIE";
+
+    uint8_t eflag = c->cold->peer.pk ? _TRIP_PREFIX_EMASK : 0;
+
+    return trip_pack(blen, buf, FMT,
+        (uint8_t)(_TRIP_CONTROL_PING | eflag),
+        c->peerid,
+        _tripc_seq(c),
+
+        kind,
+        random,
+        c->ping.timestamp,
+        c->cold->self.stat.rtt,
+        c->cold->self.stat.sent,
+        c->cold->self.stat.recv,
+        delay
+        );
+}
+
 size_t
 _tripc_send_ping(_trip_connection_t *c, size_t blen, void *buf)
 {
-    static const char FMT[] =   "CQWenQIIIE";
-
     if (c->hassend && c->ping.isactive)
     {
 #if DEBUG_CONNECTION
         printf("%s\n", __func__);
 #endif
-        unsigned char nonce[_TRIP_NONCE];
-        uint8_t eflag = c->peer.pk ? _TRIP_PREFIX_EMASK : 0;
-        uint64_t seq =_tripc_seq(c);
-
         c->hassend = false;
-        size_t wlen = trip_pack(blen, buf, FMT, 
-            (uint8_t)(_TRIP_CONTROL_PING | eflag),
-            c->peer.id,
-            seq,
 
-            _tripc_prep_nonce(c->self.nonce, nonce, seq, _TRIP_CONTROL_PING),
-            c->peer.pk,
+        if (!c->ping.tries++)
+        {
+            c->ping.sentat = triptime_now();
+        }
+        else
+        {
+            /* The last send went unanswered. */
+            pmtu_loss(&c->pmtu);
+        }
+
+        /* Above base, pad to the confirmed size so losses tell on it. */
+        size_t size = pmtu_get(&c->pmtu);
+        bool pad = pmtu_raised(&c->pmtu) && size <= blen;
+        size_t wlen = _tripc_pack_ping(c, pad ? size : blen, buf,
+                                       _TRIP_PING_REQUEST, c->ping.nonce, 0);
 
-            c->ping.nonce,
-            c->ping.timestamp,
-            c->self.stat.rtt,
-            c->self.stat.sent,
-            c->self.stat.recv,
+        if (pad && NPOS != wlen)
+        {
+            memset((unsigned char *)buf + wlen, 0, size - wlen);
+            wlen = size;
+        }
 
-            c->peer.pk
-            );
         return wlen;
     }
     else
@@ -470,6 +668,196 @@ _tripc_send_ping(_trip_connection_t *c, size_t blen, void *buf)
     }
 }
 
+/**
+ * Challenge a new source, or answer a peer's challenge.
+ * @return Zero if there is nothing to send for the path.
+ */
+size_t
+_tripc_send_path(_trip_connection_t *c, size_t blen, void *buf)
+{
+    if (c->cold->path.sendprobe)
+    {
+        c->cold->path.sendprobe = false;
+        c->dst = c->cold->path.src;
+        return _tripc_pack_ping(c, blen, buf, _TRIP_PING_REQUEST, c->cold->path.nonce, 0);
+    }
+
+    if (c->cold->path.sendecho)
+    {
+        c->cold->path.sendecho = false;
+        uint64_t held = triptime_now() - c->cold->path.echoat;
+        return _tripc_pack_ping(c, blen, buf, _TRIP_PING_REPLY, c->cold->path.echo, (uint32_t)held);
+    }
+
+    return 0;
+}
+
+/**
+ * Probe a larger path MTU with a PING padded to the size under test.
+ * @return Zero if no probe is due or it won't fit the buffer.
+ */
+size_t
+_tripc_send_probe(_trip_connection_t *c, size_t blen, void *buf)
+{
+    size_t size = pmtu_next(&c->pmtu, triptime_now(), rtt_rto(&c->rtt));
+
+    if (!size || size > blen)
+    {
+        return 0;
+    }
+
+    size_t wlen = _tripc_pack_ping(c, size, buf, _TRIP_PING_REQUEST, c->pmtu.nonce, 0);
+
+    if (NPOS == wlen)
+    {
+        return 0;
+    }
+
+    memset((unsigned char *)buf + wlen, 0, size - wlen);
+
+    return size;
+}
+
+/**
+ * Seal our side of the connection into a ticket for the client, with a
+ * fresh secret the client keeps for the resume.
+ * Skipped if the router has no ticket lifetime or it won't fit.
+ * The secret relies on the 'e' section being encrypted, so TRIPOPT_TICKET
+ * is refused until trip_pack seals it.
+ */
+size_t
+_tripc_send_ticket(_trip_connection_t *c, size_t blen, void *buf)
+{
+    static const char FMT[] =   "CQWenkbE";
+
+    _trip_router_t *r = c->router;
+    c->cold->sendticket = false;
+
+    connrec_t rec;
+    memset(&rec, 0, sizeof(rec));
+    _tripc_capture(c, &rec);
+    /* The server's record never carries a ticket of its own. */
+    rec.ticketlen = 0;
+    rec.ticket = NULL;
+    randombytes_buf(rec.ticketsecret, _TICKET_SECRET);
+
+    size_t tlen = ticket_len(&rec);
+    unsigned char *ticket = tripm_alloc(tlen);
+    size_t wlen = 0;
+
+    if (ticket)
+    {
+        tlen = ticket_seal(r->ticketkey, triptime_now(), &rec, tlen, ticket);
+    }
+
+    if (ticket && NPOS != tlen)
+    {
+        unsigned char nonce[_TRIP_NONCE] = { 0 };
+        uint8_t eflag = c->cold->peer.pk ? _TRIP_PREFIX_EMASK : 0;
+        uint64_t seq =_tripc_seq(c);
+
+        if (c->cold->self.nonce)
+        {
+            _tripc_prep_nonce(nonce, c->cold->self.nonce, _TRIP_CONTROL_TICK, seq);
+        }
+
+        wlen = trip_pack(blen, buf, FMT,
+            (uint8_t)(_TRIP_CONTROL_TICK | eflag),
+            c->peerid,
+            seq,
+
+            nonce,
+
+            rec.ticketsecret,
+            (uint32_t)tlen,
+            ticket
+            );
+
+        if (NPOS == wlen)
+        {
+            /* Too large for a segment; go without. */
+            wlen = 0;
+        }
+    }
+
+    sodium_memzero(&rec, sizeof(rec));
+    tripm_cfree(ticket);
+
+    return wlen;
+}
+
+/**
+ * Present the ticket so the server rebuilds its side, with the salt both
+ * sides derive the new keys from.
+ * Data may follow in the same flight; it is accepted once the ticket is.
+ */
+size_t
+_tripc_send_resume(_trip_connection_t *c, size_t blen, void *buf)
+{
+    static const char FMT[] =   "CQWnkb";
+
+    return trip_pack(blen, buf, FMT,
+        (uint8_t)_TRIP_CONTROL_RESUME,
+        c->peerid,
+        _tripc_seq(c),
+
+        c->cold->resumesalt,
+        c->cold->resumetag,
+        (uint32_t)c->cold->ticketlen,
+        c->cold->ticket
+        );
+}
+
+/**
+ * Announce our next generation; resent until the peer confirms.
+ */
+size_t
+_tripc_send_renew(_trip_connection_t *c, size_t blen, void *buf)
+{
+    static const char FMT[] =   "CQWeWnkE";
+
+    uint8_t eflag = c->cold->peer.pk ? _TRIP_PREFIX_EMASK : 0;
+    uint64_t seq = _tripc_seq(c);
+
+    c->cold->renew.sendrenew = false;
+    c->cold->renew.resend = triptime_deadline(_RENEW_RESEND_MS);
+    /* Restated on each resend so it never falls behind the peer's floor. */
+    c->cold->renew.seq = seq;
+
+    return trip_pack(blen, buf, FMT,
+        (uint8_t)(_TRIP_CONTROL_RENEW | eflag),
+        c->peerid,
+        seq,
+
+        c->cold->renew.seq,
+        c->cold->renew.nonce,
+        c->cold->renew.pk
+        );
+}
+
+/**
+ * Echo the generation the peer retired so it knows which RENEW took.
+ */
+size_t
+_tripc_send_renew_confirm(_trip_connection_t *c, size_t blen, void *buf)
+{
+    static const char FMT[] =   "CQWeWnkE";
+
+    uint8_t eflag = c->cold->peer.pk ? _TRIP_PREFIX_EMASK : 0;
+
+    c->cold->renew.sendconfirm = false;
+
+    return trip_pack(blen, buf, FMT,
+        (uint8_t)(_TRIP_CONTROL_RENEW_CONFIRM | eflag),
+        c->peerid,
+        _tripc_seq(c),
+
+        c->cold->renew.peerseq,
+        c->cold->renew.peernonce,
+        c->cold->renew.peerpk
+        );
+}
+
 /**
  * Note that we only need to parse the data in the encrypted section.
  * OPEN packets are entangled with the router's responsibilities of filtering.
@@ -518,11 +906,11 @@ _tripc_parse_open(_trip_connection_t *c, size_t len, const unsigned char *buf)
     printf("%s: PASSED OPEN PARSED id(%lx):\n", __func__, id);
 #endif
 
-    c->peer.id = id;
-    c->peer.lim.credit = maxcredits;
-    c->peer.lim.stream = maxstreams;
-    c->peer.lim.message_size = maxmessagesize;
-    c->peer.lim.message = maxmessages;
+    c->peerid = id;
+    c->cold->peer.lim.credit = maxcredits;
+    c->cold->peer.lim.stream = maxstreams;
+    c->cold->peer.lim.message_size = maxmessagesize;
+    c->cold->peer.lim.message = maxmessages;
 
     if (are_zeros(_TRIP_NONCE, nonce) || are_zeros(TRIP_KEY_PUB, key))
     {
@@ -531,10 +919,10 @@ _tripc_parse_open(_trip_connection_t *c, size_t len, const unsigned char *buf)
     }
     else
     {
-        c->peer.nonce = tripm_alloc(_TRIP_NONCE);
-        c->peer.pk = tripm_alloc(TRIP_KEY_PUB);
-        memcpy(c->peer.nonce, nonce, _TRIP_NONCE);
-        memcpy(c->peer.pk, key, TRIP_KEY_PUB);
+        c->cold->peer.nonce = tripm_alloc(_TRIP_NONCE);
+        c->cold->peer.pk = tripm_alloc(TRIP_KEY_PUB);
+        memcpy(c->cold->peer.nonce, nonce, _TRIP_NONCE);
+        memcpy(c->cold->peer.pk, key, TRIP_KEY_PUB);
     }
 
     return 0;
@@ -561,7 +949,7 @@ _tripc_parse_chal(_trip_connection_t *c, size_t len, const unsigned char *buf)
 
     // TODO inject OPEN
     size_t olen = trip_unpack(len, buf, FMT,
-        c->self.sk,
+        c->cold->self.sk,
         &id,
         n,
         k,
@@ -583,11 +971,11 @@ _tripc_parse_chal(_trip_connection_t *c, size_t len, const unsigned char *buf)
     printf("%s: PASSED CHAL PARSED id(%lx):\n", __func__, id);
 #endif
 
-    c->peer.id = id;
-    c->peer.lim.credit = maxcredits;
-    c->peer.lim.stream = maxstreams;
-    c->peer.lim.message_size = maxmessagesize;
-    c->peer.lim.message = maxmessages;
+    c->peerid = id;
+    c->cold->peer.lim.credit = maxcredits;
+    c->cold->peer.lim.stream = maxstreams;
+    c->cold->peer.lim.message_size = maxmessagesize;
+    c->cold->peer.lim.message = maxmessages;
 
     if (are_zeros(_TRIP_NONCE, nonce) || are_zeros(TRIP_KEY_PUB, key))
     {
@@ -596,10 +984,10 @@ _tripc_parse_chal(_trip_connection_t *c, size_t len, const unsigned char *buf)
     }
     else
     {
-        c->peer.nonce = tripm_alloc(_TRIP_NONCE);
-        c->peer.pk = tripm_alloc(TRIP_KEY_PUB);
-        memcpy(c->peer.nonce, nonce, _TRIP_NONCE);
-        memcpy(c->peer.pk, key, TRIP_KEY_PUB);
+        c->cold->peer.nonce = tripm_alloc(_TRIP_NONCE);
+        c->cold->peer.pk = tripm_alloc(TRIP_KEY_PUB);
+        memcpy(c->cold->peer.nonce, nonce, _TRIP_NONCE);
+        memcpy(c->cold->peer.pk, key, TRIP_KEY_PUB);
     }
 
     return 0;
@@ -612,72 +1000,335 @@ _tripc_parse_data(_trip_connection_t *c)
     return EINVAL;
 }
 
+/**
+ * Feed an unambiguous round trip to the estimator.
+ * Pings report our smoothed RTT to the peer.
+ */
+static void
+_tripc_rtt_sample(_trip_connection_t *c, uint64_t ms, uint32_t delay)
+{
+    rtt_sample(&c->rtt, ms > UINT32_MAX ? UINT32_MAX : (uint32_t)ms, delay);
+    c->cold->self.stat.rtt = rtt_srtt(&c->rtt);
+}
+
 // TODO make sure to check that we aren't being ping spammed.
+/**
+ * A request is echoed back as a reply. A reply is matched against our
+ * path, probe, and ping nonces and otherwise dropped, so a stale or
+ * replayed reply can't start the peers echoing to each other.
+ * An echo of our path nonce answers a challenge; the router checks where
+ * it came from.
+ * @param pong - Set if the reply answers our outstanding ping.
+ */
 int
-_tripc_parse_ping(_trip_connection_t *c, size_t len, const unsigned char *buf, _trip_prefix_t *prefix)
+_tripc_parse_ping(_trip_connection_t *c, size_t len, const unsigned char *buf,
+                  bool *pong)
 {
-    static const char FMT[] =   "enQIIIE";
+    static const char FMT[] =   "eCnQIIIIE";
 
-    if (c->hassend && (c->ping.isactive || c->incoming))
-    {
 #if DEBUG_CONNECTION
-        printf("%s\n", __func__);
+    printf("%s\n", __func__);
 #endif
-        unsigned char nonce[_TRIP_NONCE];
-        unsigned char rnonce[_TRIP_NONCE];
-        uint64_t time;
-        uint32_t rtt;
-        uint32_t sent;
-        uint32_t recv;
+    uint8_t kind;
+    unsigned char rnonce[_TRIP_NONCE];
+    uint64_t time;
+    uint32_t rtt;
+    uint32_t sent;
+    uint32_t recv;
+    uint32_t delay;
+
+    *pong = false;
+
+    size_t plen = trip_unpack(len, buf, FMT,
+        &kind,
+        rnonce,
+        &time,
+        &rtt,
+        &sent,
+        &recv,
+        &delay
+        );
 
-        c->hassend = false;
-        size_t plen = trip_unpack(len, buf, FMT, 
-            _tripc_prep_nonce(c->peer.nonce, nonce, prefix->seq, prefix->control),
-            c->peer.pk,
-
-            rnonce,
-            &time,
-            &rtt,
-            &sent,
-            &recv
-            );
+    /* Path MTU probes are padded with zeros. */
+    if (NPOS == plen || plen > len
+        || !are_zeros(len - plen, (unsigned char *)buf + plen))
+    {
+        return EINVAL;
+    }
 
-        if (plen != len)
+    if (_TRIP_PING_REQUEST == kind)
+    {
+        if (_TRIPC_STATE_PING == c->state
+            || _TRIPC_STATE_READY == c->state
+            || _TRIPC_STATE_READY_PING == c->state)
         {
-            return EINVAL;
+            memcpy(c->cold->path.echo, rnonce, _TRIP_NONCE);
+            c->cold->path.echoat = triptime_now();
+            c->cold->path.sendecho = true;
+            _tripc_set_send(c);
         }
-        // TODO do something with ping information
     }
-    else
+    else if (_TRIP_PING_REPLY != kind)
     {
         return EINVAL;
     }
-
+    else if (c->cold->path.probing && !sodium_memcmp(rnonce, c->cold->path.nonce, _TRIP_NONCE))
+    {
+        c->cold->path.answered = true;
+    }
+    else if (pmtu_ack(&c->pmtu, rnonce))
+    {
+        /* Segments may be larger now. */
+    }
+    else if (!sodium_memcmp(rnonce, c->ping.nonce, _TRIP_NONCE))
+    {
+        /* Karn: a resent PING can't tell which send was answered. */
+        if (1 == c->ping.tries)
+        {
+            _tripc_rtt_sample(c, triptime_now() - c->ping.sentat, delay);
+        }
+        c->ping.tries = 0;
+        pmtu_delivered(&c->pmtu);
+        *pong = true;
+    }
+    // TODO do something with ping information
 
     return 0;
 }
 
+/**
+ * Keep the newest ticket and its secret; the ticket is opaque to us.
+ */
 int
-_tripc_parse_disconnect(_trip_connection_t *c)
-{
-    c = c;
-    return EINVAL;
-}
-
-int
-_tripc_read(_trip_connection_t *c, _trip_prefix_t *prefix, size_t len, const unsigned char *buf)
+_tripc_parse_ticket(_trip_connection_t *c, size_t len, const unsigned char *buf)
 {
-#if DEBUG_CONNECTION
-    printf("%s: control(%u) id(%lu) sequence(%lu)\n", __func__, prefix->control, prefix->id, prefix->seq);
-#endif
+    static const char FMT[] =   "enkbE";
 
-    if (_tripc_check_seq(c, prefix->seq))
+    if (c->incoming)
     {
         return EINVAL;
     }
 
-    len = len; buf = buf;
-    switch (c->state)
+    unsigned char nonce[_TRIP_NONCE];
+    unsigned char secret[_TICKET_SECRET];
+    uint32_t tlen = 0;
+    unsigned char *ticket = NULL;
+
+    size_t plen = trip_unpack(len, buf, FMT,
+        nonce,
+
+        secret,
+        &tlen,
+        &ticket
+        );
+
+    if (plen != len || tlen <= _TICKET_OVERHEAD)
+    {
+        return EINVAL;
+    }
+
+    unsigned char *dup = tripm_bdup(tlen, ticket);
+
+    if (!dup)
+    {
+        return ENOMEM;
+    }
+
+    tripm_cfree(c->cold->ticket);
+    c->cold->ticket = dup;
+    c->cold->ticketlen = tlen;
+    memcpy(c->cold->ticketsecret, secret, _TICKET_SECRET);
+    sodium_memzero(secret, _TICKET_SECRET);
+
+    return 0;
+}
+
+static int
+_tripc_renew_overlap(_trip_connection_t *c)
+{
+    return c->router->renewms;
+}
+
+/**
+ * Switch to the peer's new generation at once; the old one opens packets
+ * still in flight until the overlap ends.
+ * Packets of the old generation are told apart by the key that opens
+ * them, so they are checked against peerseqfloor rather than the new one.
+ * The floor only moves forward, and no further back than a window before
+ * the RENEW itself, so no accepted sequence is reopened.
+ */
+int
+_tripc_parse_renew(_trip_connection_t *c, size_t len, const unsigned char *buf, _trip_prefix_t *prefix)
+{
+    static const char FMT[] =   "eWnkE";
+
+    uint64_t seq = 0;
+    unsigned char nonce[_TRIP_NONCE];
+    unsigned char key[TRIP_KEY_PUB];
+
+    size_t plen = trip_unpack(len, buf, FMT,
+        &seq,
+        nonce,
+        key
+        );
+
+    if (plen != len || !seq || !c->cold->peer.pk)
+    {
+        return EINVAL;
+    }
+
+    if (!sodium_memcmp(key, c->cold->peer.pk, TRIP_KEY_PUB))
+    {
+        /* Already switched; our confirm was lost. */
+        c->cold->renew.sendconfirm = true;
+        _tripc_set_send(c);
+        return 0;
+    }
+
+    if (seq < c->seqfloor || seq > prefix->seq || prefix->seq - seq > c->window)
+    {
+        return EINVAL;
+    }
+
+    unsigned char *pk = tripm_bdup(TRIP_KEY_PUB, key);
+    unsigned char *n = tripm_bdup(_TRIP_NONCE, nonce);
+
+    if (!pk || !n)
+    {
+        tripm_cfree(pk);
+        tripm_cfree(n);
+        return ENOMEM;
+    }
+
+    /* A generation still overlapping is dropped for the newer one. */
+    _tripc_wipe_key(&c->cold->renew.peerpk, TRIP_KEY_PUB);
+    _tripc_wipe_key(&c->cold->renew.peernonce, _TRIP_NONCE);
+
+    c->cold->renew.peerpk = c->cold->peer.pk;
+    c->cold->renew.peernonce = c->cold->peer.nonce;
+    c->cold->renew.peerseqfloor = c->seqfloor;
+    c->cold->renew.peerseq = prefix->seq;
+    c->cold->renew.peerdeadline = triptime_deadline(_tripc_renew_overlap(c));
+
+    c->cold->peer.pk = pk;
+    c->cold->peer.nonce = n;
+    c->seqfloor = seq;
+
+    c->cold->renew.sendconfirm = true;
+    _tripc_set_send(c);
+
+    return 0;
+}
+
+/**
+ * @return True if key matches ours; a missing key was sent as zeros.
+ */
+static bool
+_tripc_is_key(unsigned char *key, const unsigned char *ours, size_t len)
+{
+    return ours ? !sodium_memcmp(key, ours, len) : are_zeros(len, key);
+}
+
+/**
+ * The peer seals with our new key now, start doing the same with theirs.
+ */
+static void
+_tripc_renew_switch(_trip_connection_t *c)
+{
+    unsigned char *sk = c->cold->self.sk;
+
+    _tripc_wipe_key(&c->cold->self.pk, TRIP_KEY_PUB);
+    _tripc_wipe_key(&c->cold->self.nonce, _TRIP_NONCE);
+
+    c->cold->self.pk = c->cold->renew.pk;
+    c->cold->self.sk = c->cold->renew.sk;
+    c->cold->self.nonce = c->cold->renew.nonce;
+
+    /* Retired secret opens what the peer sealed before it switched. */
+    c->cold->renew.pk = NULL;
+    c->cold->renew.sk = sk;
+    c->cold->renew.nonce = NULL;
+    c->cold->renew.pending = false;
+    c->cold->renew.sendrenew = false;
+    c->cold->renew.selfdeadline = triptime_deadline(_tripc_renew_overlap(c));
+    c->cold->renew.bytes = 0;
+    c->cold->renew.packets = 0;
+}
+
+int
+_tripc_parse_renew_confirm(_trip_connection_t *c, size_t len, const unsigned char *buf)
+{
+    static const char FMT[] =   "eWnkE";
+
+    uint64_t seq = 0;
+    unsigned char nonce[_TRIP_NONCE];
+    unsigned char key[TRIP_KEY_PUB];
+
+    size_t plen = trip_unpack(len, buf, FMT,
+        &seq,
+        nonce,
+        key
+        );
+
+    if (plen != len || !seq)
+    {
+        return EINVAL;
+    }
+
+    if (!c->cold->renew.pending)
+    {
+        /* Duplicate of one already applied. */
+        return 0;
+    }
+
+    if (!_tripc_is_key(key, c->cold->self.pk, TRIP_KEY_PUB)
+        || !_tripc_is_key(nonce, c->cold->self.nonce, _TRIP_NONCE))
+    {
+        return EINVAL;
+    }
+
+    _tripc_renew_switch(c);
+
+    return 0;
+}
+
+int
+_tripc_parse_disconnect(_trip_connection_t *c)
+{
+    c = c;
+    return EINVAL;
+}
+
+int
+_tripc_read(_trip_connection_t *c, _trip_prefix_t *prefix, size_t len, const unsigned char *buf)
+{
+#if DEBUG_CONNECTION
+    printf("%s: control(%u) id(%lu) sequence(%lu)\n", __func__, prefix->control, prefix->id, prefix->seq);
+#endif
+
+    if (_tripc_check_seq(c, prefix->seq))
+    {
+        return EINVAL;
+    }
+
+    c->lastpkt = triptime_now();
+
+    if (_TRIP_CONTROL_DATA == prefix->control)
+    {
+        c->activity = c->lastpkt;
+    }
+
+    /* The server has our ticket's connection back. */
+    if (c->resuming)
+    {
+        c->resuming = false;
+        _tripc_cancel_timeout(c);
+    }
+
+    _tripc_renew_expire(c);
+
+    len = len; buf = buf;
+    switch (c->state)
     {
         case _TRIPC_STATE_START:
             {
@@ -718,7 +1369,8 @@ _tripc_read(_trip_connection_t *c, _trip_prefix_t *prefix, size_t len, const uns
                 }
                 else if (_TRIP_CONTROL_PING == prefix->control)
                 {
-                    if (_tripc_parse_ping(c, len, buf, prefix))
+                    bool pong;
+                    if (_tripc_parse_ping(c, len, buf, &pong))
                     {
                         return EINVAL;
                     }
@@ -745,12 +1397,38 @@ _tripc_read(_trip_connection_t *c, _trip_prefix_t *prefix, size_t len, const uns
                 }
                 else if (_TRIP_CONTROL_PING == prefix->control)
                 {
-                    if (_tripc_parse_ping(c, len, buf, prefix))
+                    bool pong;
+                    if (_tripc_parse_ping(c, len, buf, &pong))
                     {
                         return EINVAL;
                     }
 
-                    _tripc_set_state(c, _TRIPC_STATE_READY);
+                    /* Only an answer to our own ping ends the PING state. */
+                    if (pong && _TRIPC_STATE_READY != c->state)
+                    {
+                        _tripc_set_state(c, _TRIPC_STATE_READY);
+                    }
+                }
+                else if (_TRIP_CONTROL_TICK == prefix->control)
+                {
+                    if (_tripc_parse_ticket(c, len, buf))
+                    {
+                        return EINVAL;
+                    }
+                }
+                else if (_TRIP_CONTROL_RENEW == prefix->control)
+                {
+                    if (_tripc_parse_renew(c, len, buf, prefix))
+                    {
+                        return EINVAL;
+                    }
+                }
+                else if (_TRIP_CONTROL_RENEW_CONFIRM == prefix->control)
+                {
+                    if (_tripc_parse_renew_confirm(c, len, buf))
+                    {
+                        return EINVAL;
+                    }
                 }
                 else if (_TRIP_CONTROL_DISC == prefix->control)
                 {
@@ -778,7 +1456,8 @@ _tripc_read(_trip_connection_t *c, _trip_prefix_t *prefix, size_t len, const uns
                 }
                 else if (_TRIP_CONTROL_PING == prefix->control)
                 {
-                    if (_tripc_parse_ping(c, len, buf, prefix))
+                    bool pong;
+                    if (_tripc_parse_ping(c, len, buf, &pong))
                     {
                         return EINVAL;
                     }
@@ -816,18 +1495,42 @@ _tripc_read(_trip_connection_t *c, _trip_prefix_t *prefix, size_t len, const uns
 
     _tripc_flag_seq(c, prefix->seq);
 
-    return c->error;
+    return c->cold->error;
 }
 
 /**
- * @return Zero on finish; NPOS or >len on error; otherwise number of bytes written.
+ * Count what is sealed with the current keys and renew when due.
  */
-size_t
-_tripc_send(_trip_connection_t *c, size_t len, void *buf)
+static void
+_tripc_renew_sent(_trip_connection_t *c, size_t len)
+{
+    _trip_router_t *r = c->router;
+
+    c->cold->renew.bytes += len;
+    ++c->cold->renew.packets;
+
+    if (c->cold->renew.pending)
+    {
+        if (!c->cold->renew.sendrenew && triptime_now() >= c->cold->renew.resend)
+        {
+            c->cold->renew.sendrenew = true;
+            _tripc_set_send(c);
+        }
+    }
+    else if ((r->renewbytes && c->cold->renew.bytes >= r->renewbytes)
+        || (r->renewpackets && c->cold->renew.packets >= r->renewpackets))
+    {
+        _tripc_renew(c);
+    }
+}
+
+static size_t
+_tripc_send_state(_trip_connection_t *c, size_t len, void *buf)
 {
 #if DEBUG_CONNECTION
     printf("%s: state(%s)\n", __func__, _tripc_state_str(c->state));
 #endif
+    size_t wlen = 0;
 
     switch (c->state)
     {
@@ -885,11 +1588,66 @@ _tripc_send(_trip_connection_t *c, size_t len, void *buf)
                  * after a timeout of expecting the PING.
                  * The ping is sent once and we move back to READY.
                  */
+                if ((wlen = _tripc_send_path(c, len, buf)))
+                {
+                    return wlen;
+                }
+
                 return _tripc_send_ping(c, len, buf);
             }
             break;
         case _TRIPC_STATE_READY:
             {
+                if ((wlen = _tripc_send_path(c, len, buf)))
+                {
+                    return wlen;
+                }
+
+                if (c->resuming && c->hassend)
+                {
+                    c->hassend = false;
+                    return _tripc_send_resume(c, len, buf);
+                }
+
+                if (c->cold->renew.sendconfirm)
+                {
+                    return _tripc_send_renew_confirm(c, len, buf);
+                }
+
+                if (c->cold->renew.sendrenew)
+                {
+                    return _tripc_send_renew(c, len, buf);
+                }
+
+                if ((wlen = _tripc_send_probe(c, len, buf)))
+                {
+                    return wlen;
+                }
+
+                if (c->cold->sendticket)
+                {
+                    int dst = c->cold->ticketdst;
+                    size_t wlen = _tripc_send_ticket(c, len, buf);
+
+                    c->cold->ticketdst = -1;
+
+                    if (wlen && dst >= 0)
+                    {
+                        c->dst = dst;
+                    }
+
+                    if (wlen)
+                    {
+                        return wlen;
+                    }
+                }
+
+                /* Fill segments to the path, never past it. */
+                if (len > pmtu_get(&c->pmtu))
+                {
+                    len = pmtu_get(&c->pmtu);
+                }
+
                 return _tripc_send_data(c, len, buf);
             }
             break;
@@ -898,6 +1656,11 @@ _tripc_send(_trip_connection_t *c, size_t len, void *buf)
                 /* This state is so we can send a reactive ping before
                  * switching back to the READY state.
                  */
+                if ((wlen = _tripc_send_path(c, len, buf)))
+                {
+                    return wlen;
+                }
+
                 return _tripc_send_ping(c, len, buf);
             }
             break;
@@ -920,19 +1683,62 @@ _tripc_send(_trip_connection_t *c, size_t len, void *buf)
     }
 }
 
+/**
+ * @return Zero on finish; NPOS or >len on error; otherwise number of bytes written.
+ */
+size_t
+_tripc_send(_trip_connection_t *c, size_t len, void *buf)
+{
+    if (c->src < 0)
+    {
+        /* Restored and the peer isn't found yet. */
+        return 0;
+    }
+
+    c->dst = c->src;
+
+    size_t wlen = _tripc_send_state(c, len, buf);
+
+    if (wlen && NPOS != wlen && wlen <= len)
+    {
+        /* The peer hears from us; no keepalive needed for a while. */
+        c->lastpkt = triptime_now();
+
+        if (_TRIPC_STATE_READY == c->state)
+        {
+            _tripc_renew_sent(c, wlen);
+        }
+    }
+
+    return wlen;
+}
+
 /**
  * Initialize the connection information with defaults.
+ * The cold part must already be attached, see _trip_new_connection.
  */
 void
 _tripc_init(_trip_connection_t *c, _trip_router_t *r, bool incoming)
 {
+    _trip_connection_cold_t *cold = c->cold;
     memset(c, 0, sizeof(*c));
+    memset(cold, 0, sizeof(*cold));
+    c->cold = cold;
     c->router = r;
     c->incoming = incoming;
-    streammap_init(&c->streams, r->max_streams);
-    c->maxresolve = 500;
-    c->maxstatems = 3000;
-    c->statems = 100;
+    c->cold->self.lim.stream = r->max_streams;
+    streammap_init(&c->streams);
+    messageq_init(&c->msg);
+    c->weight = 1;
+    c->cold->ticketdst = -1;
+    c->cold->maxresolve = 500;
+    c->cold->maxstatems = 3000;
+    c->cold->statems = 100;
+    /* The handshake has no samples, so the old fixed start it is. */
+    rtt_init(&c->rtt, (uint32_t)c->cold->statems);
+    c->activity = triptime_now();
+    c->lastpkt = c->activity;
+    pmtu_init(&c->pmtu, r->basepmtu, r->maxpmtu);
 }
 
 /**
@@ -941,17 +1747,33 @@ _tripc_init(_trip_connection_t *c, _trip_router_t *r, bool incoming)
 void
 _tripc_destroy(_trip_connection_t *c)
 {
+    _trip_stream_t *s = NULL;
+
+    while (NULL != (s = streammap_last(&c->streams)))
+    {
+        _tripc_free_stream(c, s);
+    }
+
     streammap_destroy(&c->streams);
 
-    if (c->statetimer)
+    if (c->cold->statetimer)
     {
-        _trip_cancel_timeout(c->statetimer);
-        c->statetimer = NULL;
+        _trip_cancel_timeout(c->cold->statetimer);
+        c->cold->statetimer = NULL;
     }
 
     _trip_unqconnection(c->router, c);
+    keepalive_del(&c->router->keepalive, c);
 
-    c->errmsg = tripm_cfree(c->errmsg);
+    c->cold->errmsg = tripm_cfree(c->cold->errmsg);
+    c->cold->ticket = tripm_cfree(c->cold->ticket);
+    sodium_memzero(c->cold->ticketsecret, _TICKET_SECRET);
+
+    _tripc_wipe_key(&c->cold->renew.pk, TRIP_KEY_PUB);
+    _tripc_wipe_key(&c->cold->renew.sk, TRIP_KEY_SEC);
+    _tripc_wipe_key(&c->cold->renew.nonce, _TRIP_NONCE);
+    _tripc_wipe_key(&c->cold->renew.peerpk, TRIP_KEY_PUB);
+    _tripc_wipe_key(&c->cold->renew.peernonce, _TRIP_NONCE);
 }
 
 int
@@ -977,7 +1799,7 @@ _tripc_flag_seq(_trip_connection_t *c, uint64_t seq)
 int
 _tripc_check_open_seq(_trip_connection_t *c, uint32_t seq)
 {
-    if (seq < c->peer.seqfloor)
+    if (seq < c->seqfloor)
     {
         return EINVAL;
     }
@@ -1001,10 +1823,10 @@ _tripc_check_open_seq(_trip_connection_t *c, uint32_t seq)
 void
 _tripc_flag_open_seq(_trip_connection_t *c, uint32_t seq)
 {
-    uint32_t offset = seq - c->peer.seqfloor;
-    if (offset > c->peer.window)
+    uint32_t offset = seq - c->seqfloor;
+    if (offset > c->window)
     {
-        c->peer.seqfloor += offset - c->peer.window;
+        c->seqfloor += offset - c->window;
     }
 }
 
@@ -1071,6 +1893,11 @@ _tripc_set_state(_trip_connection_t *c, enum _tripc_state state)
             break;
     }
 
+    if (_TRIPC_STATE_READY == c->state)
+    {
+        keepalive_del(&c->router->keepalive, c);
+    }
+
     c->state = state;
 
     /* When entering the state, do this. */
@@ -1084,14 +1911,14 @@ _tripc_set_state(_trip_connection_t *c, enum _tripc_state state)
         case _TRIPC_STATE_RESOLVE:
             {
                 /* Set a timeout. */
-                _tripc_set_timeout(c, c->maxresolve, _tripc_timeout_state_resolve_cb);
+                _tripc_set_timeout(c, c->cold->maxresolve, _tripc_timeout_state_resolve_cb);
             }
             break;
         case _TRIPC_STATE_OPEN:
             {
                 _tripc_mk_keys(c);
-                _tripc_set_deadline(c, c->maxstatems);
-                _tripc_set_growth(c, c->statems);
+                _tripc_set_deadline(c, c->cold->maxstatems);
+                _tripc_set_growth(c, (int)rtt_rto(&c->rtt));
                 _tripc_set_send(c);
                 _tripc_set_timeout(c, _tripc_get_growth(c), _tripc_timeout_state_resend_cb);
             }
@@ -1101,8 +1928,8 @@ _tripc_set_state(_trip_connection_t *c, enum _tripc_state state)
                 _tripc_mk_keys(c);
                 // TODO set deadline to abandon connection
 #if 0
-                _tripc_set_deadline(c, c->maxstatems);
-                _tripc_set_growth(c, c->statems);
+                _tripc_set_deadline(c, c->cold->maxstatems);
+                _tripc_set_growth(c, c->cold->statems);
                 _tripc_set_timeout(c, _tripc_get_growth(c), _tripc_timeout_state_resend_cb);
 #endif
             }
@@ -1111,21 +1938,28 @@ _tripc_set_state(_trip_connection_t *c, enum _tripc_state state)
             {
                 _tripc_generate_ping(c);
                 _tripc_set_deadline(c, c->ping.maxms);
-                _tripc_set_growth(c, c->ping.ms);
+                _tripc_set_growth(c, (int)rtt_rto(&c->rtt));
                 _tripc_set_timeout(c, _tripc_get_growth(c), _tripc_timeout_state_resend_cb);
                 _tripc_set_send(c);
             }
             break;
         case _TRIPC_STATE_READY:
             {
+                if (c->incoming && c->router->ticketms && !c->cold->ticketsent)
+                {
+                    /* Once per connection, or per wake. */
+                    c->cold->ticketsent = true;
+                    c->cold->sendticket = true;
+                    _tripc_set_send(c);
+                }
                 _tripc_set_deadline(c, c->ping.maxms * 2);
-                _tripc_set_timeout(c, c->ping.maxms + c->ping.maxms/2, _tripc_timeout_state_ready_ping);
+                _trip_keepalive(c->router, c, triptime_now() + (uint64_t)_tripc_keepalive_ms(c));
             }
             break;
         case _TRIPC_STATE_CLOSE:
             {
-                _tripc_set_deadline(c, c->maxstatems);
-                _tripc_set_timeout(c, c->statems, _tripc_timeout_state_ready_ping);
+                _tripc_set_deadline(c, c->cold->maxstatems);
+                _tripc_set_timeout(c, c->cold->statems, _tripc_timeout_state_ready_ping);
             }
             break;
         case _TRIPC_STATE_END:
@@ -1147,18 +1981,8 @@ _tripc_set_state(_trip_connection_t *c, enum _tripc_state state)
 void
 _tripc_send_add(_trip_connection_t *c, _trip_msg_t *m)
 {
-    if (c->msg.sendend[m->priority])
-    {
-        c->msg.sendend[m->priority]->next = m;
-        c->msg.sendend[m->priority] = m;
-    }
-    else
-    {
-        c->msg.sendbeg[m->priority] = m;
-        c->msg.sendend[m->priority] = m;
-    }
-
-    m->next = NULL;
+    c->activity = triptime_now();
+    messageq_add(&c->msg, m);
 }
 
 /**
@@ -1168,50 +1992,27 @@ _tripc_send_add(_trip_connection_t *c, _trip_msg_t *m)
 _trip_msg_t *
 _tripc_send_pick(_trip_connection_t *c)
 {
-    c->msg.sendwhich = (c->msg.sendwhich + 1) & c->msg.sendmask;
-
-    int which = c->msg.sendwhich ? _TRIP_MESSAGE_PRIORITY : _TRIP_MESSAGE_WHENEVER;
+    return messageq_pick(&c->msg);
+}
 
-    if (c->msg.sendbeg[which])
-    {
-        return c->msg.sendbeg[which];
-    }
-    else
-    {
-        which = 0x01 & (which + 1);
-        if (c->msg.sendbeg[which])
-        {
-            return c->msg.sendbeg[which];
-        }
-        else
-        {
-            return NULL;
-        }
-    }
+/**
+ * @brief A segment was packed from the picked message, round-robin streams.
+ */
+void
+_tripc_send_yield(_trip_connection_t *c)
+{
+    messageq_yield(&c->msg);
 }
 
 /**
- * @brief Remove the message.
- * @param m - The message should be at the front of its Q.
+ * @brief The last of the message was packed; the stream finishes it.
+ * @param m - The message should be at the front of its Q; it is freed.
  */
 void
 _tripc_send_clear(_trip_connection_t *c, _trip_msg_t *m)
 {
-    if (m == c->msg.sendbeg[m->priority])
-    {
-        if (c->msg.sendbeg[m->priority] == c->msg.sendend[m->priority])
-        {
-            c->msg.sendbeg[m->priority] = NULL;
-            c->msg.sendend[m->priority] = NULL;
-        }
-        else
-        {
-            c->msg.sendbeg[m->priority] = m->next;
-        }
-
-        m->next = NULL;
-    }
-
+    messageq_clear(&c->msg, m);
+    _trips_done_message(m->stream, m);
 }
 
 
@@ -1246,6 +2047,20 @@ _tripc_start(_trip_connection_t *c)
 void
 _tripc_resolved(_trip_connection_t *c)
 {
+    if (_TRIPC_STATE_READY == c->state)
+    {
+        /* Restored; the peer is found again. */
+        if (c->resuming)
+        {
+            _tripc_resume_start(c);
+        }
+        else
+        {
+            _tripc_set_send(c);
+        }
+        return;
+    }
+
     _tripc_set_state(c, _TRIPC_STATE_OPEN);
 }
 
@@ -1269,9 +2084,471 @@ void
 _tripc_free_message(_trip_connection_t *c, _trip_msg_t *m)
 {
     c = c;
+    tripm_cfree(m->iov);
     tripm_free(m);
 }
 
+/* CONNECTION HIBERNATION */
+
+/**
+ * Idle means ready with nothing open or queued for the given time.
+ * Messages belong to streams, so no streams means nothing queued.
+ */
+bool
+_tripc_is_idle(_trip_connection_t *c, int ms)
+{
+    return _TRIPC_STATE_READY == c->state
+        && !c->hassend
+        && !c->insend
+        && !c->streams.size
+        && !c->cold->renew.pending
+        && triptime_now() - c->activity >= (uint64_t)ms;
+}
+
+static void
+_tripc_copy_key(connrec_t *rec, uint32_t flag, unsigned char *out, const unsigned char *key, size_t len)
+{
+    if (key)
+    {
+        memcpy(out, key, len);
+        rec->flags |= flag;
+    }
+}
+
+static int
+_tripc_unstash_key(connrec_t *rec, uint32_t flag, unsigned char *in, unsigned char **key, size_t len)
+{
+    if (rec->flags & flag)
+    {
+        *key = tripm_bdup(len, in);
+
+        if (!*key)
+        {
+            return ENOMEM;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Copy what is needed to resume into the record.
+ * Info and route are shared, not copied.
+ */
+void
+_tripc_capture(_trip_connection_t *c, connrec_t *rec)
+{
+    rec->id = c->id;
+    rec->peerid = c->peerid;
+    rec->sequence = c->sequence;
+    rec->seqmark = c->cold->seqmark;
+    rec->seqfloor = c->seqfloor;
+    rec->window = c->window;
+    rec->weight = c->weight;
+    rec->src = c->src;
+    rec->pingms = c->ping.ms;
+    rec->pingmaxms = c->ping.maxms;
+    rec->flags |= c->incoming ? _CONNREC_INCOMING : 0;
+    rec->flags |= c->encrypted ? _CONNREC_ENCRYPTED : 0;
+
+    rec->selflim = c->cold->self.lim;
+    rec->peerlim = c->cold->peer.lim;
+
+    rec->data = c->cold->data;
+    rec->opensk = c->cold->self.opensk;
+    rec->signsk = c->cold->self.signsk;
+    rec->openpk = c->cold->peer.openpk;
+    rec->signpk = c->cold->peer.signpk;
+
+    rec->ilen = c->cold->ilen;
+    rec->info = c->cold->info;
+    rec->rlen = c->cold->rlen;
+    rec->route = c->cold->route;
+    rec->ticketlen = c->cold->ticketlen;
+    rec->ticket = c->cold->ticket;
+    memcpy(rec->ticketsecret, c->cold->ticketsecret, _TICKET_SECRET);
+
+    _tripc_copy_key(rec, _CONNREC_SELF_PK, rec->selfpk, c->cold->self.pk, TRIP_KEY_PUB);
+    _tripc_copy_key(rec, _CONNREC_SELF_SK, rec->selfsk, c->cold->self.sk, TRIP_KEY_SEC);
+    _tripc_copy_key(rec, _CONNREC_SELF_NONCE, rec->selfnonce, c->cold->self.nonce, _TRIP_NONCE);
+    _tripc_copy_key(rec, _CONNREC_PEER_PK, rec->peerpk, c->cold->peer.pk, TRIP_KEY_PUB);
+    _tripc_copy_key(rec, _CONNREC_PEER_NONCE, rec->peernonce, c->cold->peer.nonce, _TRIP_NONCE);
+}
+
+/**
+ * Move what is needed to resume into the record.
+ * Owned keys are copied in and freed; the connection is left for destroy.
+ */
+void
+_tripc_hibernate(_trip_connection_t *c, connrec_t *rec)
+{
+    _tripc_capture(c, rec);
+
+    /* Record owns these now. */
+    c->cold->info = NULL;
+    c->cold->route = NULL;
+    c->cold->ticket = NULL;
+
+    _tripc_wipe_key(&c->cold->self.pk, TRIP_KEY_PUB);
+    _tripc_wipe_key(&c->cold->self.sk, TRIP_KEY_SEC);
+    _tripc_wipe_key(&c->cold->self.nonce, _TRIP_NONCE);
+    _tripc_wipe_key(&c->cold->peer.pk, TRIP_KEY_PUB);
+    _tripc_wipe_key(&c->cold->peer.nonce, _TRIP_NONCE);
+}
+
+/**
+ * Rebuild a ready connection from the record.
+ * The record is left intact on failure.
+ * @return Zero on success; ENOMEM otherwise.
+ */
+int
+_tripc_wake(_trip_connection_t *c, _trip_router_t *r, connrec_t *rec)
+{
+    _tripc_init(c, r, rec->flags & _CONNREC_INCOMING);
+
+    int code = 0;
+    code = code ? code : _tripc_unstash_key(rec, _CONNREC_SELF_PK, rec->selfpk, &c->cold->self.pk, TRIP_KEY_PUB);
+    code = code ? code : _tripc_unstash_key(rec, _CONNREC_SELF_SK, rec->selfsk, &c->cold->self.sk, TRIP_KEY_SEC);
+    code = code ? code : _tripc_unstash_key(rec, _CONNREC_SELF_NONCE, rec->selfnonce, &c->cold->self.nonce, _TRIP_NONCE);
+    code = code ? code : _tripc_unstash_key(rec, _CONNREC_PEER_PK, rec->peerpk, &c->cold->peer.pk, TRIP_KEY_PUB);
+    code = code ? code : _tripc_unstash_key(rec, _CONNREC_PEER_NONCE, rec->peernonce, &c->cold->peer.nonce, _TRIP_NONCE);
+
+    if (code)
+    {
+        tripm_cfree(c->cold->self.pk);
+        tripm_cfree(c->cold->self.sk);
+        tripm_cfree(c->cold->self.nonce);
+        tripm_cfree(c->cold->peer.pk);
+        tripm_cfree(c->cold->peer.nonce);
+        _tripc_destroy(c);
+        return code;
+    }
+
+    c->id = rec->id;
+    c->peerid = rec->peerid;
+    c->sequence = rec->sequence;
+    c->cold->seqmark = rec->seqmark;
+    c->seqfloor = rec->seqfloor;
+    c->window = rec->window;
+    c->weight = rec->weight;
+    /* Unset if from another process; see _tripc_restored. */
+    c->src = rec->src;
+    c->ping.ms = rec->pingms;
+    c->ping.maxms = rec->pingmaxms;
+    c->encrypted = rec->flags & _CONNREC_ENCRYPTED;
+
+    c->cold->self.lim = rec->selflim;
+    c->cold->peer.lim = rec->peerlim;
+
+    c->cold->data = rec->data;
+    c->cold->self.opensk = rec->opensk;
+    c->cold->self.signsk = rec->signsk;
+    c->cold->peer.openpk = rec->openpk;
+    c->cold->peer.signpk = rec->signpk;
+
+    c->cold->ilen = rec->ilen;
+    c->cold->info = rec->info;
+    rec->info = NULL;
+    c->cold->rlen = rec->rlen;
+    c->cold->route = rec->route;
+    rec->route = NULL;
+    c->cold->ticketlen = rec->ticketlen;
+    c->cold->ticket = rec->ticket;
+    rec->ticket = NULL;
+    memcpy(c->cold->ticketsecret, rec->ticketsecret, _TICKET_SECRET);
+
+    _tripc_set_state(c, _TRIPC_STATE_READY);
+
+    return 0;
+}
+
+/**
+ * Switch to keys derived for a resume so nothing is sealed again under
+ * the ticket's keys. Unencrypted connections have none to switch.
+ */
+void
+_tripc_resume_keys(_trip_connection_t *c, const ticketkeys_t *keys)
+{
+    if (!c->cold->self.pk || !c->cold->self.sk || !c->cold->self.nonce
+        || !c->cold->peer.pk || !c->cold->peer.nonce)
+    {
+        return;
+    }
+
+    size_t self = c->incoming ? 1 : 0;
+    size_t peer = 1 - self;
+
+    memcpy(c->cold->self.pk, keys->pk[self], TRIP_KEY_PUB);
+    memcpy(c->cold->self.sk, keys->sk[self], TRIP_KEY_SEC);
+    memcpy(c->cold->self.nonce, keys->nonce[self], _TRIP_NONCE);
+    memcpy(c->cold->peer.pk, keys->pk[peer], TRIP_KEY_PUB);
+    memcpy(c->cold->peer.nonce, keys->nonce[peer], _TRIP_NONCE);
+}
+
+/**
+ * Pick the salt for our RESUME and switch to the keys it derives.
+ * RESUME goes once the peer is resolved again, see _tripc_restored.
+ * @return Zero on success; EINVAL if there is no ticket.
+ */
+int
+_tripc_resume(_trip_connection_t *c)
+{
+    if (c->incoming || !c->cold->ticketlen
+        || are_zeros(_TICKET_SECRET, c->cold->ticketsecret))
+    {
+        return EINVAL;
+    }
+
+    ticketkeys_t keys;
+
+    _trip_nonce_init(c->cold->resumesalt);
+    ticket_derive(c->cold->ticketsecret, c->cold->resumesalt, &keys);
+    memcpy(c->cold->resumetag, keys.tag, _TICKET_TAG);
+    _tripc_resume_keys(c, &keys);
+    sodium_memzero(&keys, sizeof(keys));
+
+    c->resuming = true;
+
+    return 0;
+}
+
+/**
+ * Send RESUME now the peer is found, and keep resending.
+ */
+void
+_tripc_resume_start(_trip_connection_t *c)
+{
+    _tripc_set_deadline(c, c->cold->maxstatems);
+    _tripc_set_growth(c, (int)rtt_rto(&c->rtt));
+    _tripc_set_send(c);
+    _tripc_set_timeout(c, _tripc_get_growth(c), _tripc_timeout_resume_cb);
+}
+
+/**
+ * A connection restored from another process has no source.
+ * The server learns it from the first authenticated packet; the client
+ * resolves info again before anything is sent.
+ */
+void
+_tripc_restored(_trip_connection_t *c)
+{
+    c->src = -1;
+
+    if (c->incoming)
+    {
+        return;
+    }
+
+    _trip_router_t *r = c->router;
+    c->cold->resolvekey = resolveq_put(&r->resolveq, c);
+    _tripc_set_timeout(c, c->cold->maxresolve, _tripc_timeout_state_resolve_cb);
+    r->packet->resolve(r->packet, c->cold->resolvekey, c->cold->ilen, c->cold->info);
+}
+
+/**
+ * Give up on the ticket and open anew under the same ID.
+ */
+void
+_tripc_reopen(_trip_connection_t *c)
+{
+    c->resuming = false;
+    c->cold->ticket = tripm_cfree(c->cold->ticket);
+    c->cold->ticketlen = 0;
+    sodium_memzero(c->cold->ticketsecret, _TICKET_SECRET);
+
+    _tripc_wipe_key(&c->cold->peer.pk, TRIP_KEY_PUB);
+    _tripc_wipe_key(&c->cold->peer.nonce, _TRIP_NONCE);
+    c->peerid = 0;
+    c->seqfloor = 0;
+
+    _tripc_set_state(c, _TRIPC_STATE_OPEN);
+}
+
+/* CONNECTION KEEPALIVE */
+
+/**
+ * The keepalive came due. Traffic since filing counts as a keepalive
+ * since any segment carries the connection forward, so only a connection
+ * idle for the whole interval sends a PING, or hibernates.
+ */
+void
+_tripc_keepalive(_trip_connection_t *c, uint64_t now)
+{
+    _trip_router_t *r = c->router;
+
+    if (r->hibernatems && _tripc_is_idle(c, r->hibernatems) && _trip_hibernate(r, c))
+    {
+        return;
+    }
+
+    uint64_t next = c->lastpkt + (uint64_t)_tripc_keepalive_ms(c);
+
+    if (next > now)
+    {
+        _trip_keepalive(r, c, next);
+        return;
+    }
+
+    _tripc_set_state(c, _TRIPC_STATE_PING);
+}
+
+/* CONNECTION MIGRATION */
+
+/**
+ * Estimates from the old path say nothing about the new one.
+ */
+static void
+_tripc_path_reset(_trip_connection_t *c)
+{
+    memset(&c->cold->self.stat, 0, sizeof(c->cold->self.stat));
+    memset(&c->cold->peer.stat, 0, sizeof(c->cold->peer.stat));
+    c->deficit = 0;
+    pmtu_reset(&c->pmtu);
+    rtt_init(&c->rtt, (uint32_t)c->cold->statems);
+}
+
+/**
+ * An authenticated packet arrived from a source other than ours.
+ * Probe it with a PING, or move to it once the probe was answered from it.
+ * Sources that fail to answer are abandoned on the next probe.
+ */
+void
+_tripc_path_recv(_trip_connection_t *c, int src)
+{
+    if (c->cold->path.probing && src == c->cold->path.src)
+    {
+        if (c->cold->path.answered)
+        {
+            // TODO should I be notifying the packet manager of unused src?
+            c->src = src;
+            c->cold->path.probing = false;
+            c->cold->path.answered = false;
+            _tripc_path_reset(c);
+            return;
+        }
+
+        if (triptime_now() < c->cold->path.deadline)
+        {
+            /* Probe is still out. */
+            return;
+        }
+    }
+    else if (c->cold->path.probing && triptime_now() < c->cold->path.deadline)
+    {
+        /* Limit probing when sources flap. */
+        return;
+    }
+
+    _trip_nonce_init(c->cold->path.nonce);
+    c->cold->path.src = src;
+    c->cold->path.deadline = triptime_deadline(_PATH_PROBE_MS);
+    c->cold->path.probing = true;
+    c->cold->path.answered = false;
+    c->cold->path.sendprobe = true;
+    _tripc_set_send(c);
+}
+
+/* CONNECTION RENEWAL */
+
+/**
+ * Start rotating our keys. Sealing stays on the current keys until the
+ * peer confirms, see renew.h.
+ * @return Zero on success; EINVAL if unencrypted; EALREADY if pending;
+ * ENOMEM otherwise.
+ */
+int
+_tripc_renew(_trip_connection_t *c)
+{
+    if (!c->encrypted || !c->cold->self.pk || !c->cold->self.sk)
+    {
+        return EINVAL;
+    }
+
+    if (c->cold->renew.pending)
+    {
+        return EALREADY;
+    }
+
+    /* The last retired secret goes early rather than keep three. */
+    _tripc_wipe_key(&c->cold->renew.sk, TRIP_KEY_SEC);
+
+    c->cold->renew.pk = tripm_alloc(TRIP_KEY_PUB);
+    c->cold->renew.sk = tripm_alloc(TRIP_KEY_SEC);
+    c->cold->renew.nonce = tripm_alloc(_TRIP_NONCE);
+
+    if (!c->cold->renew.pk || !c->cold->renew.sk || !c->cold->renew.nonce)
+    {
+        c->cold->renew.pk = tripm_cfree(c->cold->renew.pk);
+        c->cold->renew.sk = tripm_cfree(c->cold->renew.sk);
+        c->cold->renew.nonce = tripm_cfree(c->cold->renew.nonce);
+        return ENOMEM;
+    }
+
+    trip_kp(c->cold->renew.pk, c->cold->renew.sk);
+    _trip_nonce_init(c->cold->renew.nonce);
+
+    c->cold->renew.pending = true;
+    c->cold->renew.sendrenew = true;
+    _tripc_set_send(c);
+
+    return 0;
+}
+
+/**
+ * Drop retired generations once their overlap has passed.
+ */
+void
+_tripc_renew_expire(_trip_connection_t *c)
+{
+    uint64_t now = triptime_now();
+
+    if (!c->cold->renew.pending && c->cold->renew.sk && now >= c->cold->renew.selfdeadline)
+    {
+        _tripc_wipe_key(&c->cold->renew.sk, TRIP_KEY_SEC);
+    }
+
+    if (c->cold->renew.peerpk && now >= c->cold->renew.peerdeadline)
+    {
+        _tripc_wipe_key(&c->cold->renew.peerpk, TRIP_KEY_PUB);
+        _tripc_wipe_key(&c->cold->renew.peernonce, _TRIP_NONCE);
+    }
+}
+
+/**
+ * List the key pairs that may open a packet, current generation first.
+ * @param keys - Room for _RENEW_MAX_KEYS.
+ * @return Number of pairs written.
+ */
+size_t
+_tripc_renew_keys(_trip_connection_t *c, renewkey_t *keys)
+{
+    _tripc_renew_expire(c);
+
+    const unsigned char *sks[] = { c->cold->self.sk, c->cold->renew.sk };
+    const unsigned char *pks[] = { c->cold->peer.pk, c->cold->renew.peerpk };
+    const unsigned char *nonces[] = { c->cold->peer.nonce, c->cold->renew.peernonce };
+    size_t n = 0;
+    size_t i = 0;
+
+    for (; i < 2; ++i)
+    {
+        size_t j = 0;
+
+        for (; j < 2; ++j)
+        {
+            if (sks[i] && pks[j])
+            {
+                keys[n].pk = pks[j];
+                keys[n].sk = sks[i];
+                keys[n].nonce = nonces[j];
+                ++n;
+            }
+        }
+    }
+
+    return n;
+}
+
 /* CONNECTION PUBLIC */
 
 /**
@@ -1296,6 +2573,89 @@ tripc_close(trip_connection_t *c, int gracems)
     //trip_toconn(c, _c);
 }
 
+/**
+ * @brief Write the connection's IDs, keys, sequences, and limits to a
+ * versioned blob for trip_restore_connection.
+ * This hands the connection off: restore the blob once, and stop using
+ * this one, or nonces repeat once it passes the restored sequence.
+ * @param buf - NULL to get the length needed.
+ * @return Bytes written; NPOS if not ready or cap is too small.
+ */
+size_t
+tripc_serialize(trip_connection_t *_c, size_t cap, unsigned char *buf)
+{
+    trip_toconn(c, _c);
+
+    if (_TRIPC_STATE_READY != c->state && _TRIPC_STATE_PING != c->state)
+    {
+        return NPOS;
+    }
+
+    connrec_t rec;
+    memset(&rec, 0, sizeof(rec));
+    _tripc_capture(c, &rec);
+
+    size_t len = connrec_pack_len(&rec);
+
+    if (buf)
+    {
+        len = connrec_pack(&rec, cap, buf);
+    }
+
+    sodium_memzero(&rec, sizeof(rec));
+
+    return len;
+}
+
+/**
+ * @brief Largest message that is sent in one segment on the current path.
+ * Grows as path MTU discovery confirms larger segments.
+ */
+size_t
+tripc_umtu(trip_connection_t *_c)
+{
+    trip_toconn(c, _c);
+    return pmtu_get(&c->pmtu) - _TRIPC_DATA_OVERHEAD;
+}
+
+/**
+ * @brief Set the connection's share of egress when the router is saturated.
+ * @return Zero on success; EINVAL if weight is out of range.
+ */
+int
+tripc_set_weight(trip_connection_t *_c, uint32_t weight)
+{
+    trip_toconn(c, _c);
+
+    if (!weight || weight > TRIPC_MAX_WEIGHT)
+    {
+        return EINVAL;
+    }
+
+    c->weight = weight;
+
+    return 0;
+}
+
+/**
+ * @brief Rotate the connection's keys now instead of waiting on
+ * TRIPOPT_RENEW.
+ * @return Zero on success; EINVAL if not ready or unencrypted; EALREADY if
+ * a renewal is pending; ENOMEM otherwise.
+ */
+int
+tripc_renew(trip_connection_t *_c)
+{
+    trip_toconn(c, _c);
+
+    if (_TRIPC_STATE_READY != c->state && _TRIPC_STATE_PING != c->state)
+    {
+        return EINVAL;
+    }
+
+    return _tripc_renew(c);
+}
+
 /**
  * @return The next stream ID available.
  */
@@ -1307,37 +2667,40 @@ tripc_next_stream(trip_connection_t *_c)
 }
 
 /**
+ * @param priority - Zero is sent first, up to TRIPS_PRIORITY_LEVELS - 1.
  * @return NULL if stream cannot be created.
  */
 trip_stream_t *
-tripc_open_stream(trip_connection_t *_c, int sid, int options)
+tripc_open_stream(trip_connection_t *_c, int sid, int priority, int options)
 {
     trip_toconn(c, _c);
 
-    _trip_stream_t *s = tripm_alloc(sizeof(_trip_stream_t));
+    if (priority < 0 || priority >= TRIPS_PRIORITY_LEVELS)
+    {
+        return NULL;
+    }
+
+    if ((options & TRIPS_OPT_LATEST) && (options & TRIPS_OPT_RELIABLE))
+    {
+        /* Superseded messages are never delivered. */
+        return NULL;
+    }
 
-    do
+    /* Bounded by the peer's limit once it is known. */
+    if (c->cold->peer.lim.stream
+        && (sid < 0 || (uint32_t)sid >= c->cold->peer.lim.stream))
     {
-        if (s)
-        {
-            s->data = NULL;
-            s->connection = c;
-            s->id = sid;
-            s->flags = options & _TRIPS_OPT_PUBMASK;
-            s->listbeg = NULL;
-            s->listend = NULL;
-            streammap_add(&c->streams, s);
-        }
-    } while (false);
+        return NULL;
+    }
 
-    return (trip_stream_t *)s;
+    return (trip_stream_t *)_tripc_new_stream(c, sid, priority, options);
 }
 
 int
 tripc_get_errno(trip_connection_t *_c)
 {
     trip_toconn(c, _c);
-    return c->error;
+    return c->cold->error;
 }
 
 const char *
@@ -1345,11 +2708,11 @@ tripc_get_errmsg(trip_connection_t *_c)
 {
     trip_toconn(c, _c);
 
-    if (c->error && !c->errmsg)
+    if (c->cold->error && !c->cold->errmsg)
     {
-        c->errmsg = strdup(strerror(c->error));
+        c->cold->errmsg = strdup(strerror(c->cold->error));
     }
 
-    return c->errmsg;
+    return c->cold->errmsg;
 }
 
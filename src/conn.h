@@ -31,24 +31,25 @@ extern "C" {
 #endif
 
 
+#include <assert.h>
 #include <stddef.h>
 #include <stdint.h>
 
 
 #include "connpeer.h"
+#include "connrec.h"
 #include "connself.h"
 #include "core.h"
 #include "ping.h"
+#include "pmtu.h"
+#include "rtt.h"
+#include "renew.h"
 #include "streammap.h"
+#include "ticket.h"
 #include "messageq.h"
+#include "util.h"
 
 
-enum _trip_message_q
-{
-    _TRIP_MESSAGE_PRIORITY = 0,
-    _TRIP_MESSAGE_WHENEVER = 1,
-};
-
 enum _tripc_state
 {
     _TRIPC_STATE_START,
@@ -65,27 +66,40 @@ enum _tripc_state
 
 #define _TRIP_SEQ_WINDOW (512)
 
-struct _trip_connection_s
+/* Worst case bytes of a DATA segment that are not payload:
+ * prefix, MAC, and stream control, ID, and offset.
+ */
+#define _TRIPC_DATA_OVERHEAD (1 + 8 + 9 + crypto_box_MACBYTES + 1 + 9 + 9)
+
+/* Stream IDs below this live inside the connection and never touch the heap.
+ * Each costs every live connection sizeof(_trip_stream_t); hibernated ones
+ * are records and carry none.
+ */
+#define _TRIPC_INLINE_STREAMS (4)
+
+/**
+ * Connection state used on set up, handshake retries, errors, migration
+ * and resumption, kept apart so it doesn't share lines with per-segment
+ * state. Allocated with the connection by _trip_new_connection.
+ */
+typedef struct _trip_connection_cold_s
 {
-    /* Public and Frequently Accessed */
     void *data;
+
+    /* Keys, limits and stats of each side. */
+    connself_t self;
+    connpeer_t peer;
+
+    /* Key rotation, see renew.h. */
+    renew_t renew;
+
     size_t ilen;
     unsigned char *info;
     size_t rlen;
     unsigned char *route;
-    _trip_router_t *router;
-
-    /* Packet source key. */
-    int src;
     int resolvekey;
-    
-    /* Status */
-    enum trip_connection_status status;
-    bool incoming;// if false, is primary pinger
-    bool encrypted;
 
     /* State */
-    enum _tripc_state state;
     uint64_t statedeadline;
     void *statetimer;
     int retry;
@@ -99,14 +113,70 @@ struct _trip_connection_s
     int error;
     char *errmsg;
 
-    /* Self information. */
-    connself_t self;
+    /* The router's snapshot reserved sequences below this; zero if none.
+     * Checked per sequence but passed rarely, so it stays cold.
+     */
+    uint64_t seqmark;
 
-    /* Peer information. */
-    connpeer_t peer;
+    /* Path validation after the source changes. */
+    path_t path;
 
-    /* Ping information. */
-    ping_t ping;
+    /* Resumption, see ticket.h.
+     * Servers send a ticket once ready.
+     */
+    bool sendticket;
+    bool ticketsent;
+    /* Where a resent RESUME came from, answered there; negative if none. */
+    int ticketdst;
+    size_t ticketlen;
+    unsigned char *ticket;
+    unsigned char ticketsecret[_TICKET_SECRET];
+    /* Client's RESUME, the same on every resend. */
+    unsigned char resumesalt[_TRIP_NONCE];
+    unsigned char resumetag[_TICKET_TAG];
+
+    /* Sometimes we're unable to send the buffer, store here until ready.
+     * segfull is true if just waiting to send.
+     * segment contains the final product.
+     * segwork contains unencrypted portion.
+     *
+     * TODO needed? I don't think so.
+     */
+    bool segfull;
+} _trip_connection_cold_t;
+
+struct _trip_connection_s
+{
+    /* Hot
+     * Read or written for every segment received or sent, kept at the
+     * front so _tripc_prefetch brings it in ahead of use.
+     */
+    _trip_router_t *router;
+    enum _tripc_state state;
+    /* Share of egress relative to other connections. */
+    uint32_t weight;
+
+    /* Packet source key, and where the packet being sent goes. */
+    int src;
+    int dst;
+
+    /* Our connection ID and next sequence. */
+    uint64_t id;
+    uint64_t sequence;
+
+    /* Peer connection ID and sequences
+     * Starting at zero.
+     * If we encounter a sequence less than what we have we discard it.
+     * Increment each floor with each successful packet received.
+     */
+    uint64_t peerid;
+    uint64_t seqfloor;
+    uint32_t window;
+
+    bool incoming;// if false, is primary pinger
+    bool encrypted;
+    /* Client holding a ticket, resending RESUME; see ticket.h. */
+    bool resuming;
 
     /* Used to round-robin through connections when sending data.
      * Re-used to link unused connection structs.
@@ -114,22 +184,56 @@ struct _trip_connection_s
     bool insend;
     bool hassend;
     _trip_connection_t *next;
+    /* Bytes left in the current send turn. */
+    int64_t deficit;
+
+    /* Last DATA sent or received, for hibernation. */
+    uint64_t activity;
+    /* Last segment sent or received, for keepalives. */
+    uint64_t lastpkt;
 
     /* Stream Map */
     streammap_t streams;
 
+    /* Rarely used state, see _trip_connection_cold_t. */
+    _trip_connection_cold_t *cold;
+
+    enum trip_connection_status status;
+
+    /* Ping information. */
+    ping_t ping;
+    pmtu_t pmtu;
+    rtt_t rtt;
+
+    /* Keepalive slot link, see keepalive.h. */
+    bool inka;
+    uint32_t kaslot;
+    uint64_t kawhen;
+    _trip_connection_t *kanext;
+    _trip_connection_t *kaprev;
+
     /* Message Q */
     messageq_t msg;
 
-    /* Sometimes we're unable to send the buffer, store here until ready.
-     * segfull is true if just waiting to send.
-     * segment contains the final product.
-     * segwork contains unencrypted portion.
-     *
-     * TODO needed? I don't think so.
-     */
-    bool segfull;
-};
+    /* Storage for the low stream IDs, see _TRIPC_INLINE_STREAMS. */
+    _trip_stream_t inlinestreams[_TRIPC_INLINE_STREAMS];
+} __attribute__((aligned(CACHE_LINE)));
+
+/* Bytes at the front of the connection touched for every segment. */
+#define _TRIPC_HOT_BYTES (offsetof(_trip_connection_t, cold))
+#define _TRIPC_HOT_LINES (2)
+static_assert(_TRIPC_HOT_BYTES <= _TRIPC_HOT_LINES * CACHE_LINE,
+              "Per-segment connection state outgrew its cache lines.");
+
+/**
+ * @brief Start loading the hot part of a connection about to be used.
+ */
+static inline void
+_tripc_prefetch(const _trip_connection_t *c)
+{
+    PREFETCH((const char *)c);
+    PREFETCH((const char *)c + CACHE_LINE);
+}
 
 
 void
@@ -150,11 +254,19 @@ _tripc_set_state(_trip_connection_t *c, enum _tripc_state state);
 void
 _tripc_send_add(_trip_connection_t *c, _trip_msg_t *m);
 _trip_msg_t *
+_tripc_send_pick(_trip_connection_t *c);
+void
+_tripc_send_yield(_trip_connection_t *c);
+void
+_tripc_send_clear(_trip_connection_t *c, _trip_msg_t *m);
+_trip_msg_t *
 _tripc_new_message(_trip_connection_t *c);
 void
 _tripc_free_message(_trip_connection_t *c, _trip_msg_t *m);
 void
 _tripc_close_stream(_trip_connection_t *c, _trip_stream_t *s);
+_trip_stream_t *
+_tripc_get_stream(_trip_connection_t *c, int sid);
 
 int
 _tripc_check_seq(_trip_connection_t *c, uint64_t seq);
@@ -172,6 +284,36 @@ void
 _tripc_set_send(_trip_connection_t *c);
 void
 _tripc_set_screen(_trip_connection_t *c, trip_screen_t *screen);
+void
+_tripc_path_recv(_trip_connection_t *c, int src);
+void
+_tripc_keepalive(_trip_connection_t *c, uint64_t now);
+
+bool
+_tripc_is_idle(_trip_connection_t *c, int ms);
+void
+_tripc_hibernate(_trip_connection_t *c, connrec_t *rec);
+int
+_tripc_wake(_trip_connection_t *c, _trip_router_t *r, connrec_t *rec);
+void
+_tripc_capture(_trip_connection_t *c, connrec_t *rec);
+void
+_tripc_resume_keys(_trip_connection_t *c, const ticketkeys_t *keys);
+int
+_tripc_resume(_trip_connection_t *c);
+void
+_tripc_resume_start(_trip_connection_t *c);
+void
+_tripc_restored(_trip_connection_t *c);
+void
+_tripc_reopen(_trip_connection_t *c);
+
+int
+_tripc_renew(_trip_connection_t *c);
+void
+_tripc_renew_expire(_trip_connection_t *c);
+size_t
+_tripc_renew_keys(_trip_connection_t *c, renewkey_t *keys);
 
 
 #ifdef __cplusplus
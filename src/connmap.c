@@ -1,10 +1,12 @@
 
+
 #include "connmap.h"
 
 #include <errno.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 // TODO switch to interface function for random generation
 #include <sodium.h>
 
@@ -12,6 +14,12 @@
 #include "util.h"
 
 
+/* Round mappings up to this so MAP_HUGETLB can be used. */
+#define CONNMAP_HUGE_PAGE ((size_t)1 << 21)
+/* No link; indices stay below it since connections are capped at 2^31. */
+#define CONNMAP_NIL ((uint64_t)0xFFFFFFFF)
+
+
 static uint64_t
 connmap_max_conn(void)
 {
@@ -36,20 +44,83 @@ connmap_has_free(connmap_t *map)
     return NPOS != map->free;
 }
 
+static uint64_t
+connmap_to_link(size_t index)
+{
+    return NPOS == index ? CONNMAP_NIL : (uint64_t)index;
+}
+
+static size_t
+connmap_from_link(uint64_t link)
+{
+    return CONNMAP_NIL == link ? NPOS : (size_t)link;
+}
+
+static size_t
+connmap_next(connmap_entry_t *e)
+{
+    return connmap_from_link(e->id & CONNMAP_NIL);
+}
+
+static size_t
+connmap_prev(connmap_entry_t *e)
+{
+    return connmap_from_link(e->id >> 32);
+}
+
+static void
+connmap_link(connmap_entry_t *e, size_t prev, size_t next)
+{
+    e->id = (connmap_to_link(prev) << 32) | connmap_to_link(next);
+}
+
 static void
 connmap_push(connmap_t *map, connmap_entry_t *e)
 {
     size_t eindex = connmap_index_at(map, e);
-    e->isfull = false;
-    e->u.next = map->free;
+    e->ref = 0;
+    connmap_link(e, NPOS, map->free);
+
+    if (connmap_has_free(map))
+    {
+        connmap_entry_t *head = &map->map[map->free];
+        connmap_link(head, eindex, connmap_next(head));
+    }
+
     map->free = eindex;
 }
 
+/**
+ * Take any free slot off the list.
+ */
+static void
+connmap_unlink(connmap_t *map, connmap_entry_t *e)
+{
+    size_t prev = connmap_prev(e);
+    size_t next = connmap_next(e);
+
+    if (NPOS == prev)
+    {
+        map->free = next;
+    }
+    else
+    {
+        connmap_entry_t *p = &map->map[prev];
+        connmap_link(p, connmap_prev(p), next);
+    }
+
+    if (NPOS != next)
+    {
+        connmap_entry_t *n = &map->map[next];
+        connmap_link(n, prev, connmap_next(n));
+    }
+}
+
 static connmap_entry_t *
 connmap_pop(connmap_t *map)
 {
     connmap_entry_t *e = &map->map[map->free];
-    map->free = e->u.next;
+    connmap_unlink(map, e);
     return e;
 }
 
@@ -68,6 +139,48 @@ connmap_random()
     return r;
 }
 
+/**
+ * Map every entry up front. Explicit huge pages are tried first, then
+ * regular pages advised for transparent huge pages.
+ */
+static int
+connmap_map(connmap_t *map)
+{
+    size_t cap = connmap_max(map);
+    size_t len = sizeof(connmap_entry_t) * cap;
+    len = (len + CONNMAP_HUGE_PAGE - 1) & ~(CONNMAP_HUGE_PAGE - 1);
+    void *m = MAP_FAILED;
+
+#ifdef MAP_HUGETLB
+    /* Reserved so a short huge page pool fails here, not on a later fault. */
+    m = mmap(NULL, len, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+
+    if (MAP_FAILED == m)
+    {
+        m = mmap(NULL, len, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+        if (MAP_FAILED == m)
+        {
+            return ENOMEM;
+        }
+
+#ifdef MADV_HUGEPAGE
+        /* Advisory only. */
+        madvise(m, len, MADV_HUGEPAGE);
+#endif
+    }
+
+    map->map = m;
+    map->len = len;
+    map->cap = cap;
+    map->top = 0;
+
+    return 0;
+}
+
 void
 connmap_init(connmap_t *map, uint64_t max)
 {
@@ -87,15 +200,24 @@ connmap_init(connmap_t *map, uint64_t max)
 void
 connmap_destroy(connmap_t *map)
 {
-    map->map = tripm_cfree(map->map);
+    if (map->map)
+    {
+        munmap(map->map, map->len);
+        map->map = NULL;
+    }
+
+    map->cap = 0;
+    map->len = 0;
 }
 
 void
 connmap_clear(connmap_t *map)
 {
     uint64_t max = connmap_max(map);
+    uint64_t gen = map->gen;
     connmap_destroy(map);
     connmap_init(map, max);
+    map->gen = gen + 1;
 }
 
 size_t
@@ -104,16 +226,36 @@ connmap_iter_beg(connmap_t * UNUSED(map))
     return 0;
 }
 
+static bool
+connmap_is_live(connmap_entry_t *e)
+{
+    return e->ref && !(e->ref & _CONNMAP_ASLEEP);
+}
+
+/**
+ * @return NULL if empty or hibernated.
+ */
 _trip_connection_t *
 connmap_iter_get(connmap_t *map, size_t it)
 {
-    return map->map[it].isfull ? map->map[it].u.c : NULL;
+    connmap_entry_t *e = &map->map[it];
+    return connmap_is_live(e) ? (_trip_connection_t *)e->ref : NULL;
+}
+
+/**
+ * @return Record index of a hibernated entry; NPOS otherwise.
+ */
+size_t
+connmap_iter_rec(connmap_t *map, size_t it)
+{
+    connmap_entry_t *e = &map->map[it];
+    return (e->ref & _CONNMAP_ASLEEP) ? (size_t)(e->ref >> 1) : NPOS;
 }
 
 size_t
 connmap_iter_end(connmap_t *map)
 {
-    return map->cap;
+    return map->top;
 }
 
 /**
@@ -126,64 +268,39 @@ connmap_add(connmap_t *map, _trip_connection_t *conn)
 
     do
     {
-        if (!connmap_has_free(map))
+        if (UNLIKELY(!map->map))
         {
-            /* Need more free. */
-            size_t max = connmap_max(map);
+            code = connmap_map(map);
 
-            /* Check if map is at max. */
-            if (map->size >= max)
+            if (code)
             {
-                code = ENOSPC;
                 break;
             }
+        }
 
-            /* Check if map exists. */
-            if (map->map)
-            {
-                void *m = tripm_realloc(map->map, sizeof(connmap_entry_t) * (map->cap * 2));
-                
-                if (!m)
-                {
-                    code = ENOMEM;
-                    break;
-                }
-
-                map->map = m;
-                size_t i = map->cap;
-                map->cap = map->cap * 2;
-                size_t len = map->cap;
-                for (; i < len; ++i)
-                {
-                    connmap_push(map, &map->map[i]);
-                }
-
-            }
-            else
-            {
-                void *m = tripm_alloc(sizeof(connmap_entry_t));
-
-                if (!m)
-                {
-                    code = ENOMEM;
-                    break;
-                }
+        connmap_entry_t *e = NULL;
 
-                map->map = m;
-                map->cap = 1;
-                connmap_push(map, map->map);
-            }
+        if (connmap_has_free(map))
+        {
+            e = connmap_pop(map);
+        }
+        else if (map->top < map->cap)
+        {
+            e = &map->map[map->top++];
+        }
+        else
+        {
+            code = ENOSPC;
+            break;
         }
 
-        /* There are free slots. */
-        connmap_entry_t *e = connmap_pop(map);
         /* Create ID. */
         uint64_t index = connmap_index_at(map, e);
         uint64_t r = connmap_random();
         uint64_t id = index ^ (r & ~map->mask);
-        conn->self.id = id;
-        e->isfull = true;
-        e->u.c = conn;
+        conn->id = id;
+        e->id = id;
+        e->ref = (uintptr_t)conn;
         /* Increase size. */
         ++map->size;
     } while (false);
@@ -191,25 +308,63 @@ connmap_add(connmap_t *map, _trip_connection_t *conn)
     return code;
 }
 
+/**
+ * Add the connection under an ID it already has, e.g. when restoring or
+ * resuming. Constant time, bar first touching slots up to the ID's.
+ * @return Zero on success; EEXIST if the slot is taken, or ENOMEM.
+ */
+int
+connmap_add_id(connmap_t *map, _trip_connection_t *conn, uint64_t id)
+{
+    if (UNLIKELY(!map->map))
+    {
+        int code = connmap_map(map);
+
+        if (code)
+        {
+            return code;
+        }
+    }
+
+    size_t index = connmap_index(map, id);
+
+    /* Never used slots before it become free. */
+    while (map->top <= index)
+    {
+        connmap_push(map, &map->map[map->top++]);
+    }
+
+    connmap_entry_t *e = &map->map[index];
+
+    if (e->ref)
+    {
+        return EEXIST;
+    }
+
+    connmap_unlink(map, e);
+
+    conn->id = id;
+    e->id = id;
+    e->ref = (uintptr_t)conn;
+    ++map->size;
+
+    return 0;
+}
+
 _trip_connection_t *
 connmap_del(connmap_t *map, uint64_t id)
 {
     size_t index = connmap_index(map, id);
 
-    if (index < map->cap)
+    if (index < map->top)
     {
         connmap_entry_t *e = &map->map[index];
-        if (e->isfull && id == e->u.c->self.id)
+        if (e->ref && id == e->id)
         {
-            _trip_connection_t *c = e->u.c;
+            _trip_connection_t *c = connmap_is_live(e) ? (_trip_connection_t *)e->ref : NULL;
             connmap_push(map, e);
+            ++map->gen;
             --map->size;
-
-            if (!map->size)
-            {
-                connmap_clear(map);
-            }
-
             return c;
         }
     }
@@ -222,12 +377,12 @@ connmap_get(connmap_t *map, uint64_t id)
 {
     size_t index = connmap_index(map, id);
 
-    if (LIKELY(index < map->cap))
+    if (LIKELY(index < map->top))
     {
         connmap_entry_t *e = &map->map[index];
-        if (LIKELY(e->isfull && id == e->u.c->self.id))
+        if (LIKELY(id == e->id && connmap_is_live(e)))
         {
-            return e->u.c;
+            return (_trip_connection_t *)e->ref;
         }
         else
         {
@@ -238,3 +393,42 @@ connmap_get(connmap_t *map, uint64_t id)
     return NULL;
 }
 
+/**
+ * @param rec - Set to the record index if hibernated.
+ * @return True if the ID belongs to a hibernated connection.
+ */
+bool
+connmap_asleep(connmap_t *map, uint64_t id, size_t *rec)
+{
+    size_t index = connmap_index(map, id);
+
+    if (index < map->top)
+    {
+        connmap_entry_t *e = &map->map[index];
+        if (id == e->id && (e->ref & _CONNMAP_ASLEEP))
+        {
+            *rec = (size_t)(e->ref >> 1);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Keep the ID reserved while the connection is swapped out for a record.
+ */
+void
+connmap_sleep(connmap_t *map, uint64_t id, size_t rec)
+{
+    connmap_entry_t *e = &map->map[connmap_index(map, id)];
+    e->ref = ((uintptr_t)rec << 1) | _CONNMAP_ASLEEP;
+    ++map->gen;
+}
+
+void
+connmap_wake(connmap_t *map, uint64_t id, _trip_connection_t *conn)
+{
+    connmap_entry_t *e = &map->map[connmap_index(map, id)];
+    e->ref = (uintptr_t)conn;
+}
@@ -31,19 +31,30 @@ extern "C" {
 #endif
 
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #include "conn.h"
 
 
+/* Set in an entry's ref when the connection is hibernated. */
+#define _CONNMAP_ASLEEP ((uintptr_t)1)
+
+/**
+ * The ID is kept inline so a lookup touches a single cache line.
+ */
 typedef struct connmap_entry_s
 {
-    bool isfull;
-    union
-    {
-        _trip_connection_t *c;
-        size_t next;
-    } u;
+    /* Connection ID, or the free list links when empty: the next index
+     * in the low half and the previous in the high half.
+     */
+    uint64_t id;
+    /* Zero when empty.
+     * Otherwise the connection pointer, or a hibernated connection's
+     * record index shifted up with _CONNMAP_ASLEEP set.
+     */
+    uintptr_t ref;
 } connmap_entry_t;
 
 /**
@@ -56,6 +67,10 @@ typedef struct connmap_entry_s
  * cap = 4;
  * id = 0xABCDEF11; // upper bits can be random if above max
  * (id % cap) == (id & mask) == (index == 1);
+ *
+ * All entries are mapped on first add, huge pages if the system has them,
+ * so lookups across many connections don't miss the TLB.
+ * Pages are only touched as slots are handed out.
  */
 typedef struct connmap_s
 {
@@ -63,14 +78,18 @@ typedef struct connmap_s
     uint64_t mask;
     /* Size of the map. */
     size_t size;
-    /* Capacity of the map. */
+    /* Capacity of the map, zero until mapped. */
     size_t cap;
-    /* Bitmap. */
-    // TODO bitmap_t *bitmap;
+    /* Slots handed out so far; those past it have never been used. */
+    size_t top;
+    /* Length of the mapping in bytes. */
+    size_t len;
     /* Map. */
     connmap_entry_t *map;
     /* Empty slot list. */
     size_t free;
+    /* Bumped when a live connection leaves, so lookups kept since stay valid. */
+    uint64_t gen;
 } connmap_t;
 
 void
@@ -94,12 +113,41 @@ connmap_iter_end(connmap_t *map);
 int
 connmap_add(connmap_t *map, _trip_connection_t *conn);
 
+int
+connmap_add_id(connmap_t *map, _trip_connection_t *conn, uint64_t id);
+
 _trip_connection_t *
 connmap_del(connmap_t *map, uint64_t id);
 
 _trip_connection_t *
 connmap_get(connmap_t *map, uint64_t id);
 
+/**
+ * @brief Start loading the entry for the ID ahead of connmap_get.
+ */
+static inline void
+connmap_prefetch(connmap_t *map, uint64_t id)
+{
+    size_t index = (size_t)(map->mask & id);
+
+    if (index < map->top)
+    {
+        PREFETCH(&map->map[index]);
+    }
+}
+
+bool
+connmap_asleep(connmap_t *map, uint64_t id, size_t *rec);
+
+void
+connmap_sleep(connmap_t *map, uint64_t id, size_t rec);
+
+void
+connmap_wake(connmap_t *map, uint64_t id, _trip_connection_t *conn);
+
+size_t
+connmap_iter_rec(connmap_t *map, size_t it);
+
 
 #ifdef __cplusplus
 }
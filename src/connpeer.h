@@ -35,26 +35,17 @@ extern "C" {
 #include "connstat.h"
 
 
+/* The peer's ID and sequence floor are per segment and live in the hot part
+ * of _trip_connection_t, the rest with its cold part.
+ */
 typedef struct connpeer_s
 {
-    /* Peer connection ID. */
-    uint64_t id;
-
     /* Encryption. */
     unsigned char *openpk;
     unsigned char *signpk;
     unsigned char *pk;
     unsigned char *nonce;
 
-    /* Sequences
-     * Starting at zero.
-     * If we encounter a sequence less than what we have we discard it.
-     * Currently not doing a bitset to save on space.
-     * Increment each floor with each successful packet received.
-     */
-    uint64_t seqfloor;
-    uint32_t window;
-
     /* Limits */
     connlim_t lim;
 
@@ -0,0 +1,272 @@
+
+
+#include "connrec.h"
+
+#include <string.h>
+#include <sodium.h>
+
+#include "libtrp_memory.h"
+#include "pack.h"
+#include "util.h"
+
+
+/* Box secret keys and the ticket secret are the size of public keys, so
+ * all pack as 'k'.
+ * Variable parts follow as raw bytes after their lengths.
+ */
+static const char CONNREC_FMT[] = "HCQQQQIIIIIIIIIIiikknknkIII";
+
+
+static void
+connrecs_push(connrecs_t *recs, size_t index)
+{
+    connrec_t *rec = &recs->map[index];
+    rec->flags = 0;
+    rec->id = recs->free;
+    recs->free = index;
+}
+
+void
+connrecs_init(connrecs_t *recs)
+{
+    memset(recs, 0, sizeof(connrecs_t));
+    recs->free = NPOS;
+}
+
+/**
+ * Free the table and whatever the remaining records own.
+ */
+void
+connrecs_destroy(connrecs_t *recs)
+{
+    size_t i = 0;
+
+    for (; i < recs->cap; ++i)
+    {
+        connrec_t *rec = &recs->map[i];
+
+        if (rec->flags & _CONNREC_USED)
+        {
+            tripm_cfree(rec->info);
+            tripm_cfree(rec->route);
+            tripm_cfree(rec->ticket);
+        }
+    }
+
+    recs->map = tripm_cfree(recs->map);
+    connrecs_init(recs);
+}
+
+/**
+ * @return Zeroed record; NULL if out of memory.
+ */
+connrec_t *
+connrecs_add(connrecs_t *recs, size_t *index)
+{
+    if (NPOS == recs->free)
+    {
+        size_t cap = recs->cap ? recs->cap * 2 : 64;
+        connrec_t *m = tripm_realloc(recs->map, sizeof(connrec_t) * cap);
+
+        if (!m)
+        {
+            return NULL;
+        }
+
+        recs->map = m;
+
+        /* Push in reverse so low indices are used first. */
+        size_t i = cap;
+        while (i > recs->cap)
+        {
+            connrecs_push(recs, --i);
+        }
+
+        recs->cap = cap;
+    }
+
+    *index = recs->free;
+    connrec_t *rec = &recs->map[recs->free];
+    recs->free = (size_t)rec->id;
+    memset(rec, 0, sizeof(connrec_t));
+    rec->flags = _CONNREC_USED;
+    ++recs->size;
+
+    return rec;
+}
+
+/**
+ * Release the slot. Ownership of info/route/ticket must already be taken.
+ */
+void
+connrecs_del(connrecs_t *recs, size_t index)
+{
+    sodium_memzero(&recs->map[index], sizeof(connrec_t));
+    connrecs_push(recs, index);
+    --recs->size;
+}
+
+/**
+ * @return Bytes needed to pack the record.
+ */
+size_t
+connrec_pack_len(const connrec_t *rec)
+{
+    return trip_pack_len(CONNREC_FMT) + rec->ilen + rec->rlen + rec->ticketlen;
+}
+
+/**
+ * Pack into a versioned blob. Borrowed pointers, user data, and the
+ * source are left out since they mean nothing to another process.
+ * @return Bytes written; NPOS if cap is too small.
+ */
+size_t
+connrec_pack(const connrec_t *rec, size_t cap, unsigned char *buf)
+{
+    if (cap < connrec_pack_len(rec))
+    {
+        return NPOS;
+    }
+
+    size_t len = trip_pack(cap, buf, CONNREC_FMT,
+        (uint16_t)_CONNREC_VERSION,
+        (uint8_t)(rec->flags & _CONNREC_PACKMASK),
+        rec->id,
+        rec->peerid,
+        rec->sequence,
+        rec->seqfloor,
+        rec->window,
+        rec->weight,
+        rec->selflim.credit,
+        rec->selflim.stream,
+        rec->selflim.message_size,
+        rec->selflim.message,
+        rec->peerlim.credit,
+        rec->peerlim.stream,
+        rec->peerlim.message_size,
+        rec->peerlim.message,
+        (int32_t)rec->pingms,
+        (int32_t)rec->pingmaxms,
+        rec->selfpk,
+        rec->selfsk,
+        rec->selfnonce,
+        rec->peerpk,
+        rec->peernonce,
+        rec->ticketsecret,
+        (uint32_t)rec->ilen,
+        (uint32_t)rec->rlen,
+        (uint32_t)rec->ticketlen);
+
+    if (NPOS == len)
+    {
+        return NPOS;
+    }
+
+    if (rec->ilen)
+    {
+        memcpy(buf + len, rec->info, rec->ilen);
+        len += rec->ilen;
+    }
+
+    if (rec->rlen)
+    {
+        memcpy(buf + len, rec->route, rec->rlen);
+        len += rec->rlen;
+    }
+
+    if (rec->ticketlen)
+    {
+        memcpy(buf + len, rec->ticket, rec->ticketlen);
+        len += rec->ticketlen;
+    }
+
+    return len;
+}
+
+/**
+ * Unpack a blob from connrec_pack. Info and route are copied and owned
+ * by the record; release with connrec_clear if not handed on.
+ * The source is unset; see _tripc_wake.
+ * @return Bytes read; NPOS if invalid or out of memory.
+ */
+size_t
+connrec_unpack(connrec_t *rec, size_t len, const unsigned char *buf)
+{
+    uint16_t version = 0;
+    uint8_t flags = 0;
+    uint32_t ilen = 0;
+    uint32_t rlen = 0;
+    uint32_t tlen = 0;
+
+    memset(rec, 0, sizeof(connrec_t));
+
+    size_t plen = trip_unpack(len, buf, CONNREC_FMT,
+        &version,
+        &flags,
+        &rec->id,
+        &rec->peerid,
+        &rec->sequence,
+        &rec->seqfloor,
+        &rec->window,
+        &rec->weight,
+        &rec->selflim.credit,
+        &rec->selflim.stream,
+        &rec->selflim.message_size,
+        &rec->selflim.message,
+        &rec->peerlim.credit,
+        &rec->peerlim.stream,
+        &rec->peerlim.message_size,
+        &rec->peerlim.message,
+        &rec->pingms,
+        &rec->pingmaxms,
+        rec->selfpk,
+        rec->selfsk,
+        rec->selfnonce,
+        rec->peerpk,
+        rec->peernonce,
+        rec->ticketsecret,
+        &ilen,
+        &rlen,
+        &tlen);
+
+    if (NPOS == plen || _CONNREC_VERSION != version)
+    {
+        return NPOS;
+    }
+
+    if ((size_t)ilen > len - plen
+        || (size_t)rlen > len - plen - ilen
+        || (size_t)tlen > len - plen - ilen - rlen)
+    {
+        return NPOS;
+    }
+
+    rec->flags = (flags & _CONNREC_PACKMASK) | _CONNREC_USED;
+    rec->src = -1;
+    rec->ilen = ilen;
+    rec->rlen = rlen;
+    rec->info = tripm_bdup(ilen, (unsigned char *)buf + plen);
+    rec->route = tripm_bdup(rlen, (unsigned char *)buf + plen + ilen);
+    rec->ticketlen = tlen;
+    rec->ticket = tripm_bdup(tlen, (unsigned char *)buf + plen + ilen + rlen);
+
+    if ((ilen && !rec->info) || (rlen && !rec->route) || (tlen && !rec->ticket))
+    {
+        connrec_clear(rec);
+        return NPOS;
+    }
+
+    return plen + ilen + rlen + tlen;
+}
+
+/**
+ * Free what the record owns and wipe its keys.
+ */
+void
+connrec_clear(connrec_t *rec)
+{
+    tripm_cfree(rec->info);
+    tripm_cfree(rec->route);
+    tripm_cfree(rec->ticket);
+    sodium_memzero(rec, sizeof(connrec_t));
+}
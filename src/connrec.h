@@ -0,0 +1,159 @@
+/*******************************************************************************
+ * Copyright (c) 2019 Craig Jacobson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+/**
+ * @file connrec.h
+ * @author Craig Jacobson
+ * @brief Compact records of hibernated connections.
+ *
+ * An idle connection keeps only what is needed to resume it: IDs,
+ * sequences, limits, and keys. Owned keys are copied inline so the heap
+ * copies can be freed with the rest of the connection.
+ */
+#ifndef _LIBTRP_CONNREC_H_
+#define _LIBTRP_CONNREC_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "libtrp.h"
+#include "connlim.h"
+#include "crypto.h"
+
+
+/* Record is in use. */
+#define _CONNREC_USED       (1 << 0)
+#define _CONNREC_INCOMING   (1 << 1)
+#define _CONNREC_ENCRYPTED  (1 << 2)
+/* Which inline keys are set. */
+#define _CONNREC_SELF_PK    (1 << 3)
+#define _CONNREC_SELF_SK    (1 << 4)
+#define _CONNREC_SELF_NONCE (1 << 5)
+#define _CONNREC_PEER_PK    (1 << 6)
+#define _CONNREC_PEER_NONCE (1 << 7)
+
+typedef struct connrec_s
+{
+    /* IDs and sequences. Doubles as the free list link when unused. */
+    uint64_t id;
+    uint64_t peerid;
+    uint64_t sequence;
+    uint64_t seqfloor;
+    /* Live only, never packed; see _trip_connection_cold_t. */
+    uint64_t seqmark;
+    uint32_t window;
+    uint32_t weight;
+    /* Live only, never packed: a source means nothing to another process. */
+    int src;
+    int pingms;
+    int pingmaxms;
+    uint32_t flags;
+
+    /* Limits */
+    connlim_t selflim;
+    connlim_t peerlim;
+
+    /* Borrowed from the user. */
+    void *data;
+    unsigned char *opensk;
+    unsigned char *signsk;
+    unsigned char *openpk;
+    unsigned char *signpk;
+
+    /* Owned. */
+    size_t ilen;
+    unsigned char *info;
+    size_t rlen;
+    unsigned char *route;
+    /* Resumption ticket from the server, see ticket.h. */
+    size_t ticketlen;
+    unsigned char *ticket;
+
+    /* Owned keys. */
+    unsigned char selfpk[TRIP_KEY_PUB];
+    unsigned char selfsk[TRIP_KEY_SEC];
+    unsigned char selfnonce[_TRIP_NONCE];
+    unsigned char peerpk[TRIP_KEY_PUB];
+    unsigned char peernonce[_TRIP_NONCE];
+    /* Resumes derive their keys from this; zeros if there is no ticket. */
+    unsigned char ticketsecret[crypto_generichash_KEYBYTES];
+} connrec_t;
+
+/* Version of the packed record; bump on any layout change. */
+#define _CONNREC_VERSION (4)
+/* Flags carried in a packed record. */
+#define _CONNREC_PACKMASK (0xFE)
+
+/**
+ * Records are referenced by index since the table grows by realloc.
+ */
+typedef struct connrecs_s
+{
+    /* Records in use. */
+    size_t size;
+    /* Capacity of the table. */
+    size_t cap;
+    /* Table. NULL until the first record. */
+    connrec_t *map;
+    /* Empty slot list. */
+    size_t free;
+} connrecs_t;
+
+void
+connrecs_init(connrecs_t *recs);
+
+void
+connrecs_destroy(connrecs_t *recs);
+
+connrec_t *
+connrecs_add(connrecs_t *recs, size_t *index);
+
+void
+connrecs_del(connrecs_t *recs, size_t index);
+
+size_t
+connrec_pack_len(const connrec_t *rec);
+
+size_t
+connrec_pack(const connrec_t *rec, size_t cap, unsigned char *buf);
+
+size_t
+connrec_unpack(connrec_t *rec, size_t len, const unsigned char *buf);
+
+void
+connrec_clear(connrec_t *rec);
+
+static inline connrec_t *
+connrecs_get(connrecs_t *recs, size_t index)
+{
+    return &recs->map[index];
+}
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _LIBTRP_CONNREC_H_ */
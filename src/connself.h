@@ -35,12 +35,11 @@ extern "C" {
 #include "connstat.h"
 
 
+/* The connection ID and sequence are per segment and live in the hot part
+ * of _trip_connection_t, the rest with its cold part.
+ */
 typedef struct connself_s
 {
-    /* Connection ID. */
-    uint64_t id;
-    uint64_t sequence;
-
     /* Encryption. */
     unsigned char *opensk;
     unsigned char *signsk;
@@ -0,0 +1,218 @@
+
+#include "fec.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include "libtrp_memory.h"
+#include "util.h"
+
+
+static void
+fec_reset(fec_t *f)
+{
+    f->seen = 0;
+    f->hasrepair = false;
+    f->lenx = 0;
+    memset(f->parity, 0, f->cap);
+}
+
+/**
+ * @param k - Data segments per repair segment, 1 to _TRIP_FEC_MAX_K.
+ * @param cap - Max segment payload length.
+ */
+int
+fec_init(fec_t *f, uint32_t k, size_t cap)
+{
+    if (!k || k > _TRIP_FEC_MAX_K || !cap || cap > UINT16_MAX)
+    {
+        return EINVAL;
+    }
+
+    f->parity = tripm_alloc(cap);
+
+    if (!f->parity)
+    {
+        return ENOMEM;
+    }
+
+    f->k = k;
+    f->group = 0;
+    f->cap = cap;
+    fec_reset(f);
+
+    return 0;
+}
+
+void
+fec_destroy(fec_t *f)
+{
+    f->parity = tripm_cfree(f->parity);
+}
+
+/**
+ * @brief dst ^= src. Word sized so the compiler can vectorize.
+ */
+void
+fec_xor(unsigned char *dst, const unsigned char *src, size_t len)
+{
+    size_t i = 0;
+
+    for (; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t))
+    {
+        uint64_t a;
+        uint64_t b;
+        memcpy(&a, dst + i, sizeof(a));
+        memcpy(&b, src + i, sizeof(b));
+        a ^= b;
+        memcpy(dst + i, &a, sizeof(a));
+    }
+
+    for (; i < len; ++i)
+    {
+        dst[i] ^= src[i];
+    }
+}
+
+/**
+ * @brief Account for an outgoing data segment.
+ * Once fec_enc_full the repair segment is due.
+ * @return Zero on success; EMSGSIZE if longer than cap, the segment is not
+ * covered and the group is unchanged.
+ */
+int
+fec_enc_add(fec_t *f, size_t len, const unsigned char *buf)
+{
+    if (len > f->cap)
+    {
+        return EMSGSIZE;
+    }
+
+    fec_xor(f->parity, buf, len);
+    f->lenx ^= (uint16_t)len;
+    f->seen = (f->seen << 1) | 1;
+
+    return 0;
+}
+
+/**
+ * @brief Whether the group is full and the repair segment is due.
+ */
+bool
+fec_enc_full(const fec_t *f)
+{
+    return f->seen == (uint32_t)((1ULL << f->k) - 1);
+}
+
+/**
+ * @brief Write the repair payload and start the next group.
+ * @param out - At least cap long.
+ * @return Length of the repair payload; zero if the group is empty.
+ */
+size_t
+fec_enc_repair(fec_t *f, unsigned char *out)
+{
+    if (!f->seen)
+    {
+        return 0;
+    }
+
+    /* Parity length covers the longest segment in the group. */
+    size_t len = f->cap;
+    while (len && !f->parity[len - 1])
+    {
+        --len;
+    }
+
+    out[0] = (unsigned char)(f->lenx >> 8);
+    out[1] = (unsigned char)(f->lenx & 0xFF);
+    memcpy(out + 2, f->parity, len);
+
+    ++f->group;
+    fec_reset(f);
+
+    return len + 2;
+}
+
+/**
+ * @brief Account for an incoming segment of the group.
+ * @param index - Position in the group; k is the repair segment.
+ * @return Zero on success; EINVAL if malformed; ESTALE if the group passed.
+ */
+int
+fec_dec_add(fec_t *f, uint32_t group, uint32_t index, size_t len, const unsigned char *buf)
+{
+    if (index > f->k)
+    {
+        return EINVAL;
+    }
+
+    if ((int32_t)(group - f->group) < 0)
+    {
+        return ESTALE;
+    }
+
+    if (group != f->group)
+    {
+        /* Unrecoverable losses in the previous group, move on. */
+        f->group = group;
+        fec_reset(f);
+    }
+
+    if (index == f->k)
+    {
+        if (f->hasrepair || len < 2 || len - 2 > f->cap)
+        {
+            return EINVAL;
+        }
+
+        f->lenx ^= (uint16_t)((buf[0] << 8) | buf[1]);
+        fec_xor(f->parity, buf + 2, len - 2);
+        f->hasrepair = true;
+    }
+    else
+    {
+        uint32_t bit = (uint32_t)1 << index;
+
+        if ((f->seen & bit) || len > f->cap)
+        {
+            return EINVAL;
+        }
+
+        f->lenx ^= (uint16_t)len;
+        fec_xor(f->parity, buf, len);
+        f->seen |= bit;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Rebuild the one missing data segment of the group, if possible.
+ * @param index - Set to the position of the rebuilt segment.
+ * @param out - At least cap long.
+ * @return Length of the rebuilt segment; NPOS if not recoverable.
+ */
+size_t
+fec_dec_recover(fec_t *f, uint32_t *index, unsigned char *out)
+{
+    uint32_t full = (uint32_t)((1ULL << f->k) - 1);
+    uint32_t missing = full & ~f->seen;
+
+    if (!f->hasrepair || !missing || (missing & (missing - 1)))
+    {
+        return NPOS;
+    }
+
+    size_t len = f->lenx;
+    if (len > f->cap)
+    {
+        return NPOS;
+    }
+
+    *index = (uint32_t)__builtin_ctz(missing);
+    memcpy(out, f->parity, len);
+    f->seen = full;
+
+    return len;
+}
@@ -0,0 +1,92 @@
+/*******************************************************************************
+ * Copyright (c) 2019 Craig Jacobson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+/**
+ * @file fec.h
+ * @author Craig Jacobson
+ * @brief Forward error correction by XOR parity.
+ *
+ * Every k data segments of a stream are followed by one repair segment,
+ * the XOR of the group, lengths included.
+ * Any single lost segment of a group is rebuilt without waiting for a
+ * retransmission.
+ * With k = 10 the overhead is 10%.
+ */
+#ifndef _LIBTRP_FEC_H_
+#define _LIBTRP_FEC_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+
+#define _TRIP_FEC_MAX_K (32)
+
+typedef struct fec_s
+{
+    /* Data segments per group. */
+    uint32_t k;
+    /* Current group. */
+    uint32_t group;
+    /* Bit per data segment seen in the group. */
+    uint32_t seen;
+    /* Repair segment seen for the group (decode only). */
+    bool hasrepair;
+    /* XOR of the lengths. */
+    uint16_t lenx;
+    /* XOR of the data, cap long. */
+    size_t cap;
+    unsigned char *parity;
+} fec_t;
+
+int
+fec_init(fec_t *f, uint32_t k, size_t cap);
+
+void
+fec_destroy(fec_t *f);
+
+void
+fec_xor(unsigned char *dst, const unsigned char *src, size_t len);
+
+int
+fec_enc_add(fec_t *f, size_t len, const unsigned char *buf);
+
+bool
+fec_enc_full(const fec_t *f);
+
+size_t
+fec_enc_repair(fec_t *f, unsigned char *out);
+
+int
+fec_dec_add(fec_t *f, uint32_t group, uint32_t index, size_t len, const unsigned char *buf);
+
+size_t
+fec_dec_recover(fec_t *f, uint32_t *index, unsigned char *out);
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _LIBTRP_FEC_H_ */
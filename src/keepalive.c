@@ -0,0 +1,177 @@
+
+#include "keepalive.h"
+
+#include <string.h>
+
+#include "conn.h"
+#include "time.h"
+
+
+#define _KEEPALIVE_MASK (_KEEPALIVE_SLOTS - 1)
+
+void
+keepalive_init(keepalive_t *k, uint64_t now)
+{
+    memset(k, 0, sizeof(*k));
+    k->tick = now / _KEEPALIVE_TICK_MS;
+}
+
+/**
+ * @brief File the connection for a keepalive at when.
+ * Deadlines already passed go in the next slot swept.
+ */
+void
+keepalive_add(keepalive_t *k, _trip_connection_t *c, uint64_t when)
+{
+    if (c->inka)
+    {
+        keepalive_del(k, c);
+    }
+
+    uint64_t tick = when / _KEEPALIVE_TICK_MS;
+
+    if (tick < k->tick)
+    {
+        tick = k->tick;
+    }
+
+    c->kaslot = (uint32_t)(tick & _KEEPALIVE_MASK);
+    _trip_connection_t **slot = &k->slot[c->kaslot];
+    k->used[c->kaslot / 64] |= 1ULL << (c->kaslot % 64);
+
+    c->kawhen = when;
+    c->kaprev = NULL;
+    c->kanext = *slot;
+    if (*slot)
+    {
+        (*slot)->kaprev = c;
+    }
+    *slot = c;
+    c->inka = true;
+    ++k->size;
+}
+
+void
+keepalive_del(keepalive_t *k, _trip_connection_t *c)
+{
+    if (!c->inka)
+    {
+        return;
+    }
+
+    if (k->insweep && k->cursor == c)
+    {
+        k->cursor = c->kanext;
+    }
+
+    if (c->kaprev)
+    {
+        c->kaprev->kanext = c->kanext;
+    }
+    else
+    {
+        k->slot[c->kaslot] = c->kanext;
+    }
+
+    if (c->kanext)
+    {
+        c->kanext->kaprev = c->kaprev;
+    }
+
+    if (!k->slot[c->kaslot])
+    {
+        k->used[c->kaslot / 64] &= ~(1ULL << (c->kaslot % 64));
+    }
+
+    c->kanext = NULL;
+    c->kaprev = NULL;
+    c->inka = false;
+    --k->size;
+}
+
+/**
+ * @brief Take the next connection whose keepalive is due.
+ * Call until NULL each sweep. A slot is scanned once per sweep, each call
+ * resumes where the last one stopped; connections filed into the slot
+ * during the sweep wait for the next one.
+ * @return NULL when none are due by now.
+ */
+_trip_connection_t *
+keepalive_pop(keepalive_t *k, uint64_t now)
+{
+    uint64_t end = now / _KEEPALIVE_TICK_MS;
+
+    if (end >= k->tick + _KEEPALIVE_SLOTS)
+    {
+        /* Missed laps; every slot is swept once regardless. */
+        k->tick = end - _KEEPALIVE_SLOTS + 1;
+        k->insweep = false;
+    }
+
+    /* The current tick is swept but kept, it may have more due later. */
+    for (;; ++k->tick, k->insweep = false)
+    {
+        _trip_connection_t *c = k->insweep
+                              ? k->cursor
+                              : k->slot[k->tick & _KEEPALIVE_MASK];
+
+        for (; c; c = c->kanext)
+        {
+            if (c->kawhen <= now)
+            {
+                k->insweep = true;
+                k->cursor = c->kanext;
+                keepalive_del(k, c);
+                return c;
+            }
+        }
+
+        if (k->tick >= end)
+        {
+            break;
+        }
+    }
+
+    k->insweep = false;
+
+    return NULL;
+}
+
+/**
+ * @brief When the earliest occupied slot is due; the end of its tick, so
+ * everything filed in it is due by then unless it waits for a later lap.
+ * @return Milliseconds since the epoch; TRIPTIME_END if none are filed.
+ */
+uint64_t
+keepalive_next(const keepalive_t *k)
+{
+    uint32_t start = (uint32_t)(k->tick & _KEEPALIVE_MASK);
+    uint32_t word = start / 64;
+    uint64_t low = (1ULL << (start % 64)) - 1;
+
+    /* Start's own word is looked at twice, above start then below it. */
+    int i;
+    for (i = 0; i <= _KEEPALIVE_WORDS; ++i)
+    {
+        uint32_t w = (word + (uint32_t)i) % _KEEPALIVE_WORDS;
+        uint64_t bits = k->used[w];
+
+        if (0 == i)
+        {
+            bits &= ~low;
+        }
+        else if (_KEEPALIVE_WORDS == i)
+        {
+            bits &= low;
+        }
+
+        if (bits)
+        {
+            uint32_t slot = w * 64 + (uint32_t)__builtin_ctzll(bits);
+            uint64_t ahead = (slot - start) & _KEEPALIVE_MASK;
+            return (k->tick + ahead + 1) * _KEEPALIVE_TICK_MS;
+        }
+    }
+
+    return TRIPTIME_END;
+}
@@ -0,0 +1,82 @@
+/*******************************************************************************
+ * Copyright (c) 2019 Craig Jacobson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+/**
+ * @file keepalive.h
+ * @author Craig Jacobson
+ * @brief Slots of ready connections by when their keepalive is due.
+ */
+#ifndef _LIBTRP_KEEPALIVE_H_
+#define _LIBTRP_KEEPALIVE_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "core.h"
+
+
+/* Slots are one tick wide; a lap covers _KEEPALIVE_SLOTS ticks. */
+#define _KEEPALIVE_SLOTS (256)
+#define _KEEPALIVE_TICK_MS (100)
+#define _KEEPALIVE_WORDS (_KEEPALIVE_SLOTS / 64)
+
+/**
+ * Ready connections are filed by when their keepalive is due instead of
+ * each arming a timer. One router timer sweeps the slots, armed for the
+ * earliest occupied one, see keepalive_next.
+ * Connections with traffic since they were filed are filed again from it,
+ * so only idle ones get a PING, together in one sweep.
+ * Deadlines more than a lap out share a slot with sooner ones and are
+ * skipped until their lap.
+ */
+typedef struct keepalive_s
+{
+    _trip_connection_t *slot[_KEEPALIVE_SLOTS];
+    /* Bit per occupied slot. */
+    uint64_t used[_KEEPALIVE_WORDS];
+    /* Next tick to sweep, in ticks since the epoch. */
+    uint64_t tick;
+    uint32_t size;
+    /* Where keepalive_pop stopped in the current slot, if insweep. */
+    bool insweep;
+    _trip_connection_t *cursor;
+} keepalive_t;
+
+void
+keepalive_init(keepalive_t *k, uint64_t now);
+void
+keepalive_add(keepalive_t *k, _trip_connection_t *c, uint64_t when);
+void
+keepalive_del(keepalive_t *k, _trip_connection_t *c);
+_trip_connection_t *
+keepalive_pop(keepalive_t *k, uint64_t now);
+uint64_t
+keepalive_next(const keepalive_t *k);
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _LIBTRP_KEEPALIVE_H_ */
@@ -0,0 +1,86 @@
+/*******************************************************************************
+ * Copyright (c) 2019 Craig Jacobson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+/**
+ * @file message.c
+ * @author Craig Jacobson
+ * @brief Message data access.
+ */
+#include "message.h"
+
+#include <string.h>
+
+#include "util.h"
+
+
+/**
+ * @brief Copy message data into the segment being packed.
+ *
+ * Data is read straight from the user's buffer(s), so gathered messages
+ * are never flattened into an intermediate buffer.
+ * @note For the DATA packer; _tripc_send_data is still a stub, so nothing
+ * calls this yet.
+ * @return Number of bytes copied; may be less than len at end of message.
+ */
+size_t
+_tripm_read(const _trip_msg_t *m, size_t off, size_t len, unsigned char *out)
+{
+    if (off >= m->len)
+    {
+        return 0;
+    }
+
+    if (len > m->len - off)
+    {
+        len = m->len - off;
+    }
+
+    if (LIKELY(!m->iov))
+    {
+        memcpy(out, m->buf + off, len);
+        return len;
+    }
+
+    size_t copied = 0;
+    int i;
+    for (i = 0; i < m->iovcnt && copied < len; ++i)
+    {
+        size_t ilen = m->iov[i].iov_len;
+
+        if (off >= ilen)
+        {
+            off -= ilen;
+            continue;
+        }
+
+        size_t n = ilen - off;
+        if (n > len - copied)
+        {
+            n = len - copied;
+        }
+
+        memcpy(out + copied, (const unsigned char *)m->iov[i].iov_base + off, n);
+        copied += n;
+        off = 0;
+    }
+
+    return copied;
+}
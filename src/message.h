@@ -31,27 +31,45 @@ extern "C" {
 #endif
 
 #include <stdlib.h>
+#include <sys/uio.h>
+
+#include "libtrp.h"
 
 #include "core.h"
 
 
+/* Matches the common IOV_MAX. */
+#define _TRIP_MSG_MAX_IOV (1024)
+
 struct _trip_msg_s
 {
     _trip_stream_t *stream;
     size_t len; // length, don't change
-    const unsigned char *buf; // data, don't change
+    const unsigned char *buf; // data, don't change; NULL if iov is used
+    struct iovec *iov; // gathered data, owned copy of user's array
+    int iovcnt;
+    trip_handle_release_t *release; // user buffers are done with
+    void *ctx;
+
+    size_t off; // bytes packed so far
+    uint32_t seq; // sequence within stream
 
     uint32_t id;// id or index in zone
     int zone;// 0 or 1, indicates which segment zone this message falls
-    int priority;// 0 high 1 low
     _trip_part_t *parts;// list of parts to send
 
     /* Messages are stored in a list.
      */
     _trip_msg_t *next;
+    /* Messages with data left to send are queued on their stream. */
+    _trip_msg_t *qnext;
 };
 
 
+size_t
+_tripm_read(const _trip_msg_t *m, size_t off, size_t len, unsigned char *out);
+
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,180 @@
+
+#include "messageq.h"
+
+#include <string.h>
+
+#include "message.h"
+#include "stream.h"
+#include "util.h"
+
+
+static void
+messageq_push(messageq_t *q, _trip_stream_t *s)
+{
+    int level = s->priority;
+
+    if (q->end[level])
+    {
+        q->end[level]->qnext = s;
+    }
+    else
+    {
+        q->beg[level] = s;
+        q->levels |= (uint32_t)1 << level;
+    }
+
+    q->end[level] = s;
+    s->qnext = NULL;
+    s->inq = true;
+}
+
+static _trip_stream_t *
+messageq_pop(messageq_t *q, int level)
+{
+    _trip_stream_t *s = q->beg[level];
+
+    q->beg[level] = s->qnext;
+    if (!q->beg[level])
+    {
+        q->end[level] = NULL;
+        q->levels &= ~((uint32_t)1 << level);
+    }
+
+    s->qnext = NULL;
+    s->inq = false;
+
+    return s;
+}
+
+void
+messageq_init(messageq_t *q)
+{
+    memset(q, 0, sizeof(messageq_t));
+}
+
+/**
+ * @brief Queue the message on its stream; queue the stream if idle.
+ */
+void
+messageq_add(messageq_t *q, _trip_msg_t *m)
+{
+    _trip_stream_t *s = m->stream;
+
+    if (s->sendend)
+    {
+        s->sendend->qnext = m;
+    }
+    else
+    {
+        s->sendbeg = m;
+    }
+
+    s->sendend = m;
+    m->qnext = NULL;
+
+    if (!s->inq)
+    {
+        messageq_push(q, s);
+    }
+}
+
+/**
+ * @return Message to send data from next; NULL if nothing to send.
+ */
+_trip_msg_t *
+messageq_pick(messageq_t *q)
+{
+    if (!q->levels)
+    {
+        return NULL;
+    }
+
+    int level = __builtin_ctz(q->levels);
+
+    return q->beg[level]->sendbeg;
+}
+
+/**
+ * @brief The picked stream sent a segment, let its level's next stream go.
+ */
+void
+messageq_yield(messageq_t *q)
+{
+    if (!q->levels)
+    {
+        return;
+    }
+
+    int level = __builtin_ctz(q->levels);
+
+    if (q->beg[level] != q->end[level])
+    {
+        messageq_push(q, messageq_pop(q, level));
+    }
+}
+
+/**
+ * @brief Remove the message, it has nothing left to send.
+ * @param m - The message should be at the front of its stream.
+ */
+void
+messageq_clear(messageq_t *q, _trip_msg_t *m)
+{
+    _trip_stream_t *s = m->stream;
+
+    if (m != s->sendbeg)
+    {
+        return;
+    }
+
+    s->sendbeg = m->qnext;
+    if (!s->sendbeg)
+    {
+        s->sendend = NULL;
+        messageq_del_stream(q, s);
+    }
+
+    m->qnext = NULL;
+}
+
+/**
+ * @brief Unlink the stream from its level.
+ */
+void
+messageq_del_stream(messageq_t *q, _trip_stream_t *s)
+{
+    if (!s->inq)
+    {
+        return;
+    }
+
+    int level = s->priority;
+    _trip_stream_t *p = NULL;
+    _trip_stream_t *n = q->beg[level];
+
+    while (n && n != s)
+    {
+        p = n;
+        n = n->qnext;
+    }
+
+    if (!n)
+    {
+        return;
+    }
+
+    if (p)
+    {
+        p->qnext = s->qnext;
+        if (q->end[level] == s)
+        {
+            q->end[level] = p;
+        }
+        s->qnext = NULL;
+        s->inq = false;
+    }
+    else
+    {
+        messageq_pop(q, level);
+    }
+}
@@ -31,36 +31,45 @@ extern "C" {
 #endif
 
 
+#include <stdint.h>
+
+#include "libtrp.h"
+
 #include "core.h"
 
 
+#define _TRIP_PRIORITY_LEVELS (TRIPS_PRIORITY_LEVELS)
+
+/**
+ * Stream scheduler for a connection.
+ * Streams with messages to send are queued at their priority level.
+ * The highest non-empty level (lowest number) is found from the bitmap.
+ * Streams at the same level take turns, one segment at a time.
+ * Messages within a stream go in order.
+ */
 typedef struct messageq_s
 {
-    /* Message Queues
-     * Focus on sending one message at a time.
-     * Only send partial buffers if priority and nothing else will fit.
-     * Partial buffers will flush after max_message_buffer_wait ms.
-     * Resending messages, or partial messages,
-     * jumps to the front of the appropriate Q.
-     * 0 - Priority Q.
-     * 1 - Whenever Q.
-     * 
-     * Pull next partial message from Whenever Q when which indicator reaches zero.
-     * This helps avoid starvation.
-     * sendwhich & sendmask > 0 => priority next
-     * sendwhich & sendmask = 0 => whenever next
-     *
-     * If sendmask = 0x01, then queueing is fair.
-     * If sendmask = 0x03, then priority sends first 3/4 of time, whenever 1/4.
-     */
-    uint32_t sendmask;
-    uint32_t sendwhich;
-    _trip_msg_t *sendbeg[2];
-    _trip_msg_t *sendend[2];
+    /* Bit per level with queued streams. */
+    uint32_t levels;
+    _trip_stream_t *beg[_TRIP_PRIORITY_LEVELS];
+    _trip_stream_t *end[_TRIP_PRIORITY_LEVELS];
     uint32_t nextmsgid;
     int zone;
 } messageq_t;
 
+void
+messageq_init(messageq_t *q);
+void
+messageq_add(messageq_t *q, _trip_msg_t *m);
+_trip_msg_t *
+messageq_pick(messageq_t *q);
+void
+messageq_yield(messageq_t *q);
+void
+messageq_clear(messageq_t *q, _trip_msg_t *m);
+void
+messageq_del_stream(messageq_t *q, _trip_stream_t *s);
+
 
 #ifdef __cplusplus
 }
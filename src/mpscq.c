@@ -0,0 +1,86 @@
+
+#include "mpscq.h"
+
+#include <stddef.h>
+
+
+void
+mpscq_init(mpscq_t *q)
+{
+    atomic_store_explicit(&q->stub.next, NULL, memory_order_relaxed);
+    atomic_store_explicit(&q->head, &q->stub, memory_order_relaxed);
+    q->tail = &q->stub;
+}
+
+/**
+ * @brief Any thread.
+ * @return True if the queue was empty, so the consumer may need waking.
+ */
+bool
+mpscq_push(mpscq_t *q, mpscq_node_t *n)
+{
+    atomic_store_explicit(&n->next, NULL, memory_order_relaxed);
+    mpscq_node_t *prev = atomic_exchange_explicit(&q->head, n, memory_order_acq_rel);
+    atomic_store_explicit(&prev->next, n, memory_order_release);
+
+    return prev == &q->stub;
+}
+
+/**
+ * @brief Consumer thread only.
+ * @return False if a node is queued or being linked.
+ */
+bool
+mpscq_empty(mpscq_t *q)
+{
+    return q->tail == &q->stub
+        && atomic_load_explicit(&q->head, memory_order_acquire) == &q->stub;
+}
+
+/**
+ * @brief Consumer thread only.
+ * @return NULL if empty or the next node is still being linked.
+ */
+mpscq_node_t *
+mpscq_pop(mpscq_t *q)
+{
+    mpscq_node_t *tail = q->tail;
+    mpscq_node_t *next = atomic_load_explicit(&tail->next, memory_order_acquire);
+
+    if (&q->stub == tail)
+    {
+        if (!next)
+        {
+            return NULL;
+        }
+
+        /* Skip over the stub. */
+        q->tail = next;
+        tail = next;
+        next = atomic_load_explicit(&next->next, memory_order_acquire);
+    }
+
+    if (next)
+    {
+        q->tail = next;
+        return tail;
+    }
+
+    if (tail != atomic_load_explicit(&q->head, memory_order_acquire))
+    {
+        /* A producer is between its exchange and link. */
+        return NULL;
+    }
+
+    /* Put the stub back behind the last node so it can be taken. */
+    mpscq_push(q, &q->stub);
+    next = atomic_load_explicit(&tail->next, memory_order_acquire);
+
+    if (next)
+    {
+        q->tail = next;
+        return tail;
+    }
+
+    return NULL;
+}
@@ -0,0 +1,72 @@
+/*******************************************************************************
+ * Copyright (c) 2019 Craig Jacobson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+/**
+ * @file mpscq.h
+ * @author Craig Jacobson
+ * @brief Lock-free multi-producer single-consumer queue.
+ *
+ * Intrusive, after Dmitry Vyukov's design: producers swap themselves in as
+ * the head with one atomic exchange and never wait on each other. The
+ * consumer sees a node once its producer has linked it; until then pop
+ * returns NULL and the node shows up on a later pop.
+ * Only the push onto an empty queue asks for a wake up, so a consumer that
+ * stops on NULL checks mpscq_empty before it sleeps.
+ */
+#ifndef _LIBTRP_MPSCQ_H_
+#define _LIBTRP_MPSCQ_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include <stdatomic.h>
+#include <stdbool.h>
+
+
+typedef struct mpscq_node_s
+{
+    struct mpscq_node_s *_Atomic next;
+} mpscq_node_t;
+
+typedef struct mpscq_s
+{
+    /* Producers. */
+    mpscq_node_t *_Atomic head;
+    /* Consumer only. */
+    mpscq_node_t *tail;
+    mpscq_node_t stub;
+} mpscq_t;
+
+void
+mpscq_init(mpscq_t *q);
+bool
+mpscq_push(mpscq_t *q, mpscq_node_t *n);
+mpscq_node_t *
+mpscq_pop(mpscq_t *q);
+bool
+mpscq_empty(mpscq_t *q);
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _LIBTRP_MPSCQ_H_ */
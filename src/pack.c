@@ -437,10 +437,10 @@ trip_pack(size_t cap, unsigned char *buf, const char *format, ...)
                 }
                 *buf = i;
                 ++buf;
-                tlen = rlen;
-                for (; i; --i, tlen = tlen >> 8, ++buf)
+                /* Most significant first, as unpack reads it. */
+                for (tlen = (size_t)i; tlen; --tlen, ++buf)
                 {
-                    *buf = ((size_t)0x000000FF & tlen);
+                    *buf = ((size_t)0x000000FF & ((size_t)rlen >> (8 * (tlen - 1))));
                 }
                 if (rlen)
                 {
@@ -559,9 +559,10 @@ trip_pack(size_t cap, unsigned char *buf, const char *format, ...)
                 }
                 *buf = i;
                 ++buf;
-                for (; i; --i, I = I >> 8, ++buf)
+                /* Most significant first, as unpack reads it. */
+                for (; i; --i, ++buf)
                 {
-                    *buf = (0x000000FF & I);
+                    *buf = (0x000000FF & (I >> (8 * (i - 1))));
                 }
                 break;
 
@@ -576,9 +577,10 @@ trip_pack(size_t cap, unsigned char *buf, const char *format, ...)
                 }
                 *buf = i;
                 ++buf;
-                for (; i; --i, Q = Q >> 8, ++buf)
+                /* Most significant first, as unpack reads it. */
+                for (; i; --i, ++buf)
                 {
-                    *buf = (0x00000000000000FF & Q);
+                    *buf = (0x00000000000000FF & (Q >> (8 * (i - 1))));
                 }
                 break;
 
@@ -655,6 +657,12 @@ trip_unpack(size_t blen, unsigned char *buf, const char *format, ...)
                  */
                 break;
 
+            case 'e':
+            case 'E':
+                // TODO actually decrypt
+                /* Markers only, as when packing. */
+                break;
+
             case 'n':
                 len += _TRIP_NONCE;
                 if (len > blen)
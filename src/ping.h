@@ -32,6 +32,11 @@ extern "C" {
 
 
 #include <stdbool.h>
+#include <stdint.h>
+
+
+/* A new source is probed at most this often. */
+#define _PATH_PROBE_MS (1000)
 
 
 typedef struct ping_s
@@ -41,8 +46,32 @@ typedef struct ping_s
     int maxms;
     int ms;
     bool isactive;
+    /* First send of the nonce, and sends since; only one send samples RTT. */
+    uint64_t sentat;
+    uint32_t tries;
 } ping_t;
 
+/**
+ * Validation of a new source address for the connection.
+ * An authenticated packet from src starts a PING with a fresh nonce to it;
+ * the connection moves once the peer echoes the nonce from src.
+ * Until then we keep sending to the old source.
+ */
+typedef struct path_s
+{
+    unsigned char nonce[_TRIP_NONCE];
+    uint64_t deadline;
+    int src;
+    bool probing;
+    bool answered;
+    bool sendprobe;
+
+    /* A peer's PING to answer from wherever we are now. */
+    unsigned char echo[_TRIP_NONCE];
+    uint64_t echoat;
+    bool sendecho;
+} path_t;
+
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,171 @@
+
+#include "pmtu.h"
+
+#include <string.h>
+#include <sodium.h>
+
+
+/**
+ * Next size to try, halfway between what works and what fails.
+ * @return Zero if the gap is too small to bother.
+ */
+static uint32_t
+pmtu_mid(pmtu_t *p)
+{
+    uint32_t gap = p->fail - p->mtu;
+
+    if (gap <= _PMTU_STEP)
+    {
+        return 0;
+    }
+
+    return p->mtu + gap / 2;
+}
+
+/**
+ * @param base - Size assumed to work.
+ * @param max - Largest size to try; at or below base disables discovery.
+ */
+void
+pmtu_init(pmtu_t *p, size_t base, size_t max)
+{
+    memset(p, 0, sizeof(*p));
+    p->base = (uint32_t)base;
+    p->max = (uint32_t)max;
+    pmtu_reset(p);
+}
+
+/**
+ * Start over from the base size, e.g. when the path changes.
+ */
+void
+pmtu_reset(pmtu_t *p)
+{
+    p->mtu = p->base;
+    p->fail = p->max + 1;
+    p->probe = 0;
+    p->count = 0;
+    p->losses = 0;
+    p->deadline = 0;
+    p->state = p->max > p->base ? _PMTU_STATE_SEARCH : _PMTU_STATE_DISABLED;
+}
+
+/**
+ * Advance timers and pick the size of the probe to send now.
+ * A new nonce is drawn for every probe sent.
+ * @param timeout - How long to wait for the echo, e.g. the RTO.
+ * @return Size to pad the probe to; zero if no probe is due.
+ */
+size_t
+pmtu_next(pmtu_t *p, uint64_t now, uint32_t timeout)
+{
+    switch (p->state)
+    {
+        case _PMTU_STATE_DISABLED:
+            return 0;
+
+        case _PMTU_STATE_DONE:
+            if (now < p->deadline)
+            {
+                return 0;
+            }
+
+            /* Paths get larger too. */
+            p->fail = p->max + 1;
+            p->state = _PMTU_STATE_SEARCH;
+            break;
+
+        case _PMTU_STATE_SEARCH:
+            break;
+    }
+
+    if (p->probe)
+    {
+        if (now < p->deadline)
+        {
+            /* Probe still out. */
+            return 0;
+        }
+
+        if (p->count >= _PMTU_MAX_PROBES)
+        {
+            /* Too large for the path. */
+            p->fail = p->probe;
+            p->probe = 0;
+            p->count = 0;
+        }
+    }
+
+    if (!p->probe)
+    {
+        p->probe = pmtu_mid(p);
+
+        if (!p->probe)
+        {
+            p->state = _PMTU_STATE_DONE;
+            p->deadline = now + _PMTU_RAISE_MS;
+            return 0;
+        }
+    }
+
+    ++p->count;
+    p->deadline = now + timeout;
+    randombytes_buf(p->nonce, sizeof(p->nonce));
+
+    return p->probe;
+}
+
+/**
+ * The peer echoed a PING; confirm the probe if it was ours.
+ * @return True if the nonce belonged to the probe in flight.
+ */
+bool
+pmtu_ack(pmtu_t *p, const unsigned char *nonce)
+{
+    if (!p->probe || sodium_memcmp(nonce, p->nonce, sizeof(p->nonce)))
+    {
+        return false;
+    }
+
+    p->mtu = p->probe;
+    p->probe = 0;
+    p->count = 0;
+    p->losses = 0;
+    /* Next probe goes out on the next send. */
+    p->deadline = 0;
+
+    return true;
+}
+
+/**
+ * A segment padded to the confirmed size went unanswered.
+ * After _PMTU_BLACKHOLE in a row the path is taken to have shrunk: fall
+ * back to base and search again below the size that stopped working.
+ */
+void
+pmtu_loss(pmtu_t *p)
+{
+    if (!pmtu_raised(p))
+    {
+        p->losses = 0;
+        return;
+    }
+
+    if (++p->losses < _PMTU_BLACKHOLE)
+    {
+        return;
+    }
+
+    uint32_t fail = p->mtu;
+    pmtu_reset(p);
+    p->fail = fail;
+}
+
+/**
+ * A segment padded to the confirmed size was answered; the run is broken.
+ */
+void
+pmtu_delivered(pmtu_t *p)
+{
+    p->losses = 0;
+}
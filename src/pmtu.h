@@ -0,0 +1,128 @@
+/*******************************************************************************
+ * Copyright (c) 2019 Craig Jacobson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+/**
+ * @file pmtu.h
+ * @author Craig Jacobson
+ * @brief Packetization layer path MTU discovery (RFC 8899).
+ *
+ * Segments of base size are assumed to always get through. Larger sizes
+ * are tried with PING padded to the size; the echo confirms it. A size
+ * is given up on after _PMTU_MAX_PROBES unanswered probes. The search
+ * halves the gap between the confirmed size and the smallest failed size.
+ * Once it is done, the search runs again after _PMTU_RAISE_MS in case the
+ * path got larger.
+ *
+ * Paths shrink too. While above base, keepalive PINGs are padded to the
+ * confirmed size, so a run of _PMTU_BLACKHOLE unanswered ones means the
+ * size stopped getting through: discovery falls back to base and searches
+ * again below it (black hole detection, RFC 8899 section 4.3).
+ */
+#ifndef _LIBTRP_PMTU_H_
+#define _LIBTRP_PMTU_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "crypto.h"
+
+
+/* Smallest segment size we assume every path carries. */
+#define _PMTU_BASE (1200)
+/* Largest UDP payload. */
+#define _PMTU_MAX (65507)
+#define _PMTU_MAX_PROBES (3)
+/* Unanswered segments of the confirmed size in a row before falling back. */
+#define _PMTU_BLACKHOLE (3)
+#define _PMTU_RAISE_MS (600000)
+/* Stop searching when the gap is smaller than this. */
+#define _PMTU_STEP (16)
+
+enum _pmtu_state
+{
+    _PMTU_STATE_DISABLED,
+    _PMTU_STATE_SEARCH,
+    _PMTU_STATE_DONE,
+};
+
+typedef struct pmtu_s
+{
+    /* Confirmed size; base until a probe is answered. */
+    uint32_t mtu;
+    uint32_t base;
+    uint32_t max;
+    /* Smallest size known to fail, or max + 1. */
+    uint32_t fail;
+    /* Size in flight; zero when none. */
+    uint32_t probe;
+    uint32_t count;
+    enum _pmtu_state state;
+    /* Probe timeout, or when to search again when done. */
+    uint64_t deadline;
+    /* Echoed back by the peer for the probe in flight. */
+    unsigned char nonce[_TRIP_NONCE];
+    /* Segments of the confirmed size lost in a row. */
+    uint32_t losses;
+} pmtu_t;
+
+void
+pmtu_init(pmtu_t *p, size_t base, size_t max);
+
+void
+pmtu_reset(pmtu_t *p);
+
+size_t
+pmtu_next(pmtu_t *p, uint64_t now, uint32_t timeout);
+
+bool
+pmtu_ack(pmtu_t *p, const unsigned char *nonce);
+
+void
+pmtu_loss(pmtu_t *p);
+
+void
+pmtu_delivered(pmtu_t *p);
+
+static inline size_t
+pmtu_get(const pmtu_t *p)
+{
+    return p->mtu;
+}
+
+/**
+ * Whether a larger size than base is in use, and worth watching for loss.
+ */
+static inline bool
+pmtu_raised(const pmtu_t *p)
+{
+    return p->mtu > p->base;
+}
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _LIBTRP_PMTU_H_ */
@@ -41,11 +41,19 @@ enum _trip_control
     _TRIP_CONTROL_CHAL,
     _TRIP_CONTROL_PING,
     _TRIP_CONTROL_DISC,
+    _TRIP_CONTROL_TICK,
+    _TRIP_CONTROL_RESUME,
+    _TRIP_CONTROL_RENEW,
+    _TRIP_CONTROL_RENEW_CONFIRM,
     _TRIP_CONTROL_MAX,
 };
 
 #define _TRIP_PREFIX_EMASK (0x80)
 
+/* PING kinds; only requests are answered, replies never are. */
+#define _TRIP_PING_REQUEST (0)
+#define _TRIP_PING_REPLY (1)
+
 struct _trip_prefix_s
 {
     bool encrypted;
@@ -0,0 +1,97 @@
+/*******************************************************************************
+ * Copyright (c) 2019 Craig Jacobson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+/**
+ * @file renew.h
+ * @author Craig Jacobson
+ * @brief In-band rekeying state.
+ */
+#ifndef _LIBTRP_RENEW_H_
+#define _LIBTRP_RENEW_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+/* How long a retired key generation still opens packets. */
+#define _RENEW_OVERLAP_MS (3000)
+/* Resend RENEW until confirmed at this interval. */
+#define _RENEW_RESEND_MS (500)
+/* Our secret keys by the peer's public keys, at most two of each. */
+#define _RENEW_MAX_KEYS (4)
+
+/**
+ * A RENEW rotates the sender's key and nonce only, so both sides may renew
+ * at once without conflict. Sequences carry on; the RENEW names the first
+ * one of the new generation, which becomes the peer's floor.
+ *
+ * The renewing side keeps sealing with the current keys until the
+ * confirm arrives; the new secret is already needed to open, since the
+ * peer switches on receipt. After the switch the retired secret is kept
+ * until olddeadline for packets still in flight.
+ */
+typedef struct renew_s
+{
+    /* Our pending generation; sk is also the retired one after confirm. */
+    unsigned char *pk;
+    unsigned char *sk;
+    unsigned char *nonce;
+    uint64_t seq;
+    bool pending;
+    bool sendrenew;
+    uint64_t resend;
+
+    /* The peer's retired generation. */
+    unsigned char *peerpk;
+    unsigned char *peernonce;
+    uint64_t peerseqfloor;
+    uint64_t peerseq;
+    bool sendconfirm;
+
+    /* Retired keys are dropped after these. */
+    uint64_t selfdeadline;
+    uint64_t peerdeadline;
+
+    /* Sent since the last renewal. */
+    uint64_t bytes;
+    uint64_t packets;
+} renew_t;
+
+/**
+ * One way to open a packet: our secret key with the peer's public key.
+ * nonce is the peer's base nonce for the generation.
+ */
+typedef struct renewkey_s
+{
+    const unsigned char *pk;
+    const unsigned char *sk;
+    const unsigned char *nonce;
+} renewkey_t;
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _LIBTRP_RENEW_H_ */
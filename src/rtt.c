@@ -0,0 +1,78 @@
+
+#include "rtt.h"
+
+#include <string.h>
+
+
+static uint32_t
+rtt_clamp(uint32_t rto)
+{
+    if (rto < _RTT_MIN_RTO)
+    {
+        return _RTT_MIN_RTO;
+    }
+
+    if (rto > _RTT_MAX_RTO)
+    {
+        return _RTT_MAX_RTO;
+    }
+
+    return rto;
+}
+
+/**
+ * @param rto - Timeout to use until the first sample.
+ */
+void
+rtt_init(rtt_t *r, uint32_t rto)
+{
+    memset(r, 0, sizeof(*r));
+    r->rto = rtt_clamp(rto);
+}
+
+/**
+ * @param ms - Time from send to answer.
+ * @param delay - Time the peer held it before answering.
+ */
+void
+rtt_sample(rtt_t *r, uint32_t ms, uint32_t delay)
+{
+    if (!r->sampled || ms < r->minrtt)
+    {
+        r->minrtt = ms;
+    }
+
+    if (ms >= r->minrtt + delay)
+    {
+        ms -= delay;
+    }
+
+    if (!r->sampled)
+    {
+        /* SRTT = R, RTTVAR = R/2 */
+        r->srtt8 = ms << 3;
+        r->rttvar4 = ms << 1;
+        r->sampled = true;
+    }
+    else
+    {
+        uint32_t srtt = r->srtt8 >> 3;
+        uint32_t err = ms > srtt ? ms - srtt : srtt - ms;
+
+        /* RTTVAR = 3/4 RTTVAR + 1/4 |SRTT - R|, SRTT = 7/8 SRTT + 1/8 R */
+        r->rttvar4 = r->rttvar4 - (r->rttvar4 >> 2) + err;
+        r->srtt8 = r->srtt8 - (r->srtt8 >> 3) + ms;
+    }
+
+    /* RTO = SRTT + max(G, 4 * RTTVAR) */
+    r->rto = rtt_clamp((r->srtt8 >> 3) + (r->rttvar4 > _RTT_G ? r->rttvar4 : _RTT_G));
+}
+
+/**
+ * @brief Double the timeout after one expires; kept until the next sample.
+ */
+void
+rtt_backoff(rtt_t *r)
+{
+    r->rto = rtt_clamp(r->rto * 2);
+}
@@ -0,0 +1,83 @@
+/*******************************************************************************
+ * Copyright (c) 2019 Craig Jacobson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+/**
+ * @file rtt.h
+ * @author Craig Jacobson
+ * @brief Round trip time estimation and retransmission timeout (RFC 6298).
+ *
+ * Samples only come from unambiguous round trips (Karn's rule); the
+ * caller drops samples of anything sent more than once. Time the peer
+ * held a packet before answering is taken off when the sample stays
+ * above the smallest round trip seen, so it can't make the path look
+ * faster than it has ever been.
+ */
+#ifndef _LIBTRP_RTT_H_
+#define _LIBTRP_RTT_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+/* Clock granularity, milliseconds. */
+#define _RTT_G (1)
+/* Lower than the RFC's second; ms clocks and datacenter paths want less. */
+#define _RTT_MIN_RTO (10)
+#define _RTT_MAX_RTO (60000)
+
+typedef struct rtt_s
+{
+    /* Smoothed RTT times 8 and variance times 4, for integer updates. */
+    uint32_t srtt8;
+    uint32_t rttvar4;
+    uint32_t minrtt;
+    uint32_t rto;
+    bool sampled;
+} rtt_t;
+
+void
+rtt_init(rtt_t *r, uint32_t rto);
+void
+rtt_sample(rtt_t *r, uint32_t ms, uint32_t delay);
+void
+rtt_backoff(rtt_t *r);
+
+static inline uint32_t
+rtt_srtt(const rtt_t *r)
+{
+    return r->srtt8 >> 3;
+}
+
+static inline uint32_t
+rtt_rto(const rtt_t *r)
+{
+    return r->rto;
+}
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _LIBTRP_RTT_H_ */
@@ -0,0 +1,159 @@
+
+#include "rxpool.h"
+
+#include <stdlib.h>
+
+#include "libtrp_memory.h"
+#include "util.h"
+
+
+static unsigned char *
+rxpool_data(rxbuf_t *b)
+{
+    return (unsigned char *)b + sizeof(rxbuf_t);
+}
+
+static rxbuf_t *
+rxpool_owner(rxpool_t *p, const unsigned char *buf)
+{
+    return (rxbuf_t *)((uintptr_t)buf & ~((uintptr_t)p->align - 1));
+}
+
+static rxbuf_t *
+rxpool_alloc(rxpool_t *p, size_t len)
+{
+    void *m = NULL;
+
+    if (tripm_memalign(&m, p->align, len))
+    {
+        return NULL;
+    }
+
+    return m;
+}
+
+void
+rxpool_init(rxpool_t *p, size_t buflen, size_t max)
+{
+    p->align = near_pwr2_64(buflen + sizeof(rxbuf_t));
+    p->size = 0;
+    p->max = max;
+    p->free = NULL;
+}
+
+void
+rxpool_destroy(rxpool_t *p)
+{
+    rxbuf_t *b = p->free;
+
+    while (b)
+    {
+        rxbuf_t *n = b->next;
+        tripm_free(b);
+        b = n;
+    }
+
+    p->free = NULL;
+    p->size = 0;
+}
+
+/**
+ * @return Usable length of pooled buffers.
+ */
+size_t
+rxpool_cap(rxpool_t *p)
+{
+    return p->align - sizeof(rxbuf_t);
+}
+
+/**
+ * @brief Get a buffer for a segment. Reference count starts at one.
+ * @return NULL if out of memory.
+ */
+unsigned char *
+rxpool_get(rxpool_t *p)
+{
+    rxbuf_t *b = p->free;
+
+    if (b)
+    {
+        p->free = b->next;
+        --p->size;
+    }
+    else
+    {
+        b = rxpool_alloc(p, p->align);
+
+        if (!b)
+        {
+            return NULL;
+        }
+    }
+
+    b->ref = 1;
+    b->large = false;
+    b->next = NULL;
+
+    return rxpool_data(b);
+}
+
+/**
+ * @brief Get a buffer for reassembling a message spanning segments.
+ * @return NULL if out of memory.
+ */
+unsigned char *
+rxpool_get_large(rxpool_t *p, size_t len)
+{
+    if (len <= rxpool_cap(p))
+    {
+        return rxpool_get(p);
+    }
+
+    rxbuf_t *b = rxpool_alloc(p, sizeof(rxbuf_t) + len);
+
+    if (!b)
+    {
+        return NULL;
+    }
+
+    b->ref = 1;
+    b->large = true;
+    b->next = NULL;
+
+    return rxpool_data(b);
+}
+
+/**
+ * @param buf - Any pointer into the first aligned block of the buffer.
+ */
+void
+rxpool_ref(rxpool_t *p, const unsigned char *buf)
+{
+    ++rxpool_owner(p, buf)->ref;
+}
+
+/**
+ * @brief Drop a reference. The buffer is recycled when none remain.
+ * @param buf - Any pointer into the first aligned block of the buffer.
+ */
+void
+rxpool_unref(rxpool_t *p, const unsigned char *buf)
+{
+    rxbuf_t *b = rxpool_owner(p, buf);
+
+    if (--b->ref)
+    {
+        return;
+    }
+
+    if (b->large || p->size >= p->max)
+    {
+        tripm_free(b);
+    }
+    else
+    {
+        b->next = p->free;
+        p->free = b;
+        ++p->size;
+    }
+}
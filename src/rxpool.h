@@ -0,0 +1,89 @@
+/*******************************************************************************
+ * Copyright (c) 2019 Craig Jacobson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+/**
+ * @file rxpool.h
+ * @author Craig Jacobson
+ * @brief Pool of reference counted receive buffers.
+ *
+ * Decrypted segments land in pooled buffers so messages can be loaned to
+ * the user without copying.
+ * Every buffer is aligned to the pool's alignment and data handed out
+ * always lies in the first aligned block, so the owning buffer is found
+ * by masking the data pointer.
+ */
+#ifndef _LIBTRP_RXPOOL_H_
+#define _LIBTRP_RXPOOL_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+
+typedef struct rxbuf_s
+{
+    uint32_t ref;
+    bool large;
+    struct rxbuf_s *next;
+} rxbuf_t;
+
+typedef struct rxpool_s
+{
+    /* Size and alignment of pooled buffers, power of 2. */
+    size_t align;
+    /* Number of buffers in the free list. */
+    size_t size;
+    /* Max number of buffers kept in the free list. */
+    size_t max;
+    /* Free list. */
+    rxbuf_t *free;
+} rxpool_t;
+
+void
+rxpool_init(rxpool_t *p, size_t buflen, size_t max);
+
+void
+rxpool_destroy(rxpool_t *p);
+
+size_t
+rxpool_cap(rxpool_t *p);
+
+unsigned char *
+rxpool_get(rxpool_t *p);
+
+unsigned char *
+rxpool_get_large(rxpool_t *p, size_t len);
+
+void
+rxpool_ref(rxpool_t *p, const unsigned char *buf);
+
+void
+rxpool_unref(rxpool_t *p, const unsigned char *buf);
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _LIBTRP_RXPOOL_H_ */
@@ -4,19 +4,38 @@
 #include "util.h"
 
 
+static int64_t
+sendq_grant(sendq_t *q, _trip_connection_t *c)
+{
+    return (int64_t)q->quantum * c->weight;
+}
+
 void
-sendq_init(sendq_t *q)
+sendq_init(sendq_t *q, uint32_t quantum)
 {
     q->head = NULL;
     q->tail = NULL;
+    q->quantum = quantum;
 }
 
 void
 sendq_destroy(sendq_t * q)
 {
-    sendq_init(q);
+    sendq_init(q, q->quantum);
+}
+
+/**
+ * @return Connection whose turn it is; NULL if empty.
+ */
+_trip_connection_t *
+sendq_peek(sendq_t *q)
+{
+    return q->head;
 }
 
+/**
+ * @brief Remove the head connection, it has nothing left to send.
+ */
 _trip_connection_t *
 sendq_dq(sendq_t *q)
 {
@@ -31,6 +50,7 @@ sendq_dq(sendq_t *q)
         }
         c->next = NULL;
         c->insend = false;
+        c->deficit = 0;
     }
 
     return c;
@@ -56,6 +76,7 @@ sendq_nq(sendq_t *q, _trip_connection_t *c)
     }
     c->next = NULL;
     c->insend = true;
+    c->deficit = sendq_grant(q, c);
 }
 
 void
@@ -63,22 +84,69 @@ sendq_del(sendq_t *q, _trip_connection_t *c)
 {
     if (c->insend)
     {
-        _trip_connection_t **p = &q->head;
+        _trip_connection_t *p = NULL;
         _trip_connection_t *n = q->head;
         while (n)
         {
             if (n == c)
             {
                 /* Unlink connection. */
-                *p = n->next;
+                if (p)
+                {
+                    p->next = n->next;
+                }
+                else
+                {
+                    q->head = n->next;
+                }
+
+                if (q->tail == n)
+                {
+                    q->tail = p;
+                }
                 break;
             }
 
-            p = &n->next;
+            p = n;
             n = n->next;
         }
     }
+    c->next = NULL;
     c->insend = false;
+    c->deficit = 0;
+}
+
+/**
+ * @brief Charge the connection for a segment it produced.
+ */
+void
+sendq_charge(sendq_t * UNUSED(q), _trip_connection_t *c, size_t len)
+{
+    c->deficit -= (int64_t)len;
+}
+
+/**
+ * @brief End the head connection's turn and grant its next one.
+ */
+void
+sendq_rotate(sendq_t *q)
+{
+    _trip_connection_t *c = q->head;
+
+    if (!c)
+    {
+        return;
+    }
+
+    c->deficit += sendq_grant(q, c);
+
+    if (q->head != q->tail)
+    {
+        q->head = c->next;
+        q->tail->next = c;
+        q->tail = c;
+        c->next = NULL;
+    }
 }
 
 bool
@@ -86,4 +154,3 @@ sendq_has(sendq_t *q)
 {
     return NULL != q->head;
 }
-
@@ -37,24 +37,39 @@ extern "C" {
 
 
 /**
- * Simple queue for connections that need to send messages.
+ * Deficit round-robin over connections that need to send.
+ *
+ * Only connections with data are queued, so idle connections cost nothing.
+ * The head connection sends while its deficit is positive and is charged
+ * the bytes of every segment.
+ * When the deficit is spent the turn ends, the connection moves to the tail
+ * and is granted quantum * weight bytes for its next turn.
+ * A connection leaving the queue forfeits its deficit.
  */
 typedef struct sendq_s
 {
     _trip_connection_t *head;
     _trip_connection_t *tail;
+    /* Bytes granted per unit of weight each turn. */
+    uint32_t quantum;
 } sendq_t;
 
 void
-sendq_init(sendq_t *);
+sendq_init(sendq_t *q, uint32_t quantum);
 void
 sendq_destroy(sendq_t *q);
 _trip_connection_t *
+sendq_peek(sendq_t *q);
+_trip_connection_t *
 sendq_dq(sendq_t *q);
 void
 sendq_nq(sendq_t *q, _trip_connection_t *c);
 void
 sendq_del(sendq_t *q, _trip_connection_t *c);
+void
+sendq_charge(sendq_t *q, _trip_connection_t *c, size_t len);
+void
+sendq_rotate(sendq_t *q);
 bool
 sendq_has(sendq_t *q);
 
@@ -25,11 +25,14 @@
  * @brief Stream code.
  */
 #include "libtrp.h"
+#include "libtrp_memory.h"
 #include "trip.h"
+#include "util.h"
 #include "conn.h"
 #include "stream.h"
 
 #include <errno.h>
+#include <limits.h>
 #include <stdarg.h>
 #include <string.h>
 #include <sys/epoll.h>
@@ -37,15 +40,6 @@
 
 /* STREAM INTERNALS */
 
-/**
- * @return Priority 1/0.
- */
-static int
-_trips_priority(_trip_stream_t *s)
-{
-    return s->flags & TRIPS_OPT_PRIORITY;
-}
-
 /**
  * @brief Add message to queue of messages being sent.
  */
@@ -114,31 +108,144 @@ _trips_msg_remove(_trip_stream_t *s, _trip_msg_t *mess)
     }
 }
 
+/**
+ * @brief Lift backflow once queued data drains to the low-water mark.
+ *
+ * The user is notified once when the stream goes from blocked to writable.
+ * @note Queued data drains as DATA segments complete messages, and the
+ * DATA packer (_tripc_send_data) is still a stub, so TRIPM_SENT never
+ * fires. Until it lands only a latest-value send that supersedes a
+ * larger message gets here; otherwise a stream at the high-water mark
+ * stays blocked and the writable hook never runs.
+ */
+static void
+_trips_check_writable(_trip_stream_t *s)
+{
+    _trip_router_t *r = s->connection->router;
+    bool blocked = s->flags & (_TRIPS_OPT_BACKFLOW | _TRIPS_OPT_STALLED);
+
+    if ((s->flags & _TRIPS_OPT_BACKFLOW) && s->qlen <= r->stream_lowat)
+    {
+        s->flags &= ~_TRIPS_OPT_BACKFLOW;
+    }
+
+    if (blocked
+        && !(s->flags & (_TRIPS_OPT_BACKFLOW | _TRIPS_OPT_STALLED | _TRIPS_OPT_CLOSED))
+        && r->writable)
+    {
+        r->writable((trip_stream_t *)s);
+    }
+}
+
 /* STREAM SHARED */
 
 /**
  * @brief Message incoming on stream.
+ *
+ * The buffer is from the router's receive pool, either the decrypted
+ * segment (single segment message) or a reassembly buffer.
+ * The caller keeps its own reference and drops it after delivery.
+ * When loaning, the user keeps the buffer until trip_release;
+ * otherwise it is only valid during the callback.
+ * Latest-value streams drop messages older than the last delivered.
  */
 void
-_trips_message(_trip_stream_t *s, int len, unsigned char *buf)
+_trips_message(_trip_stream_t *s, uint32_t seq, size_t len, unsigned char *buf)
 {
-    // TODO
-    s = s;
-    len = len;
-    buf = buf;
-    //s->message_cb((trip_stream_t *)s, TRIPM_RECV, (size_t)len, buf);
+    _trip_router_t *r = s->connection->router;
+
+    if (s->flags & TRIPS_OPT_LATEST)
+    {
+        if (s->hasrecv && (int32_t)(seq - s->recvseq) <= 0)
+        {
+            /* Stale, superseded by what was delivered. */
+            return;
+        }
+
+        s->recvseq = seq;
+        s->hasrecv = true;
+    }
+
+    if (r->flag & _TRIPR_FLAG_RECV_LOAN)
+    {
+        rxpool_ref(&r->rxpool, buf);
+    }
+
+    r->message((trip_stream_t *)s, TRIPM_RECV, len, buf);
 }
 
 /**
  * @brief Message was sent and confirmed received per stream requirements.
+ * Called from _tripc_send_clear; there are no acknowledgements yet, so a
+ * message is done once its last segment is packed.
  */
 void
 _trips_done_message(_trip_stream_t *s, _trip_msg_t *m)
 {
     _trips_msg_remove(s, m);
+    s->qlen -= m->len;
+
+    if (m->release)
+    {
+        m->release((trip_stream_t *)s, TRIPM_SENT, m->ctx);
+    }
 
     //s->message_cb((trip_stream_t *)s, TRIPM_SENT, m->len, m->buf);
     _tripc_free_message(s->connection, m);
+    _trips_check_writable(s);
+}
+
+/**
+ * @brief Set up a stream in place; the memory may be inline or heap.
+ */
+void
+_trips_init(_trip_stream_t *s, _trip_connection_t *c, int sid, int priority, int options)
+{
+    memset(s, 0, sizeof(*s));
+    s->connection = c;
+    s->id = sid;
+    s->flags = options & _TRIPS_OPT_PUBMASK;
+    s->priority = priority;
+    s->gen = ++c->router->streamgen;
+}
+
+/**
+ * The router, connection ID and stream ID are fixed from open, so this
+ * reads the same from any thread while the stream lives.
+ */
+static trip_streamref_t
+_trips_ref(_trip_stream_t *s)
+{
+    _trip_connection_t *c = s->connection;
+
+    return (trip_streamref_t){
+        .router = (trip_router_t *)c->router,
+        .connid = c->id,
+        .gen = s->gen,
+        .streamid = s->id,
+    };
+}
+
+/**
+ * @brief Router thread. Find the stream a reference names.
+ * @return NULL if it closed, even if its IDs were reused since.
+ */
+_trip_stream_t *
+_trips_resolve(_trip_router_t *r, const trip_streamref_t *ref)
+{
+    _trip_connection_t *c = connmap_get(&r->conn, ref->connid);
+    if (!c)
+    {
+        return NULL;
+    }
+
+    _trip_stream_t *s = streammap_get(&c->streams, ref->streamid);
+    if (!s || s->gen != ref->gen)
+    {
+        return NULL;
+    }
+
+    return s;
 }
 
 /**
@@ -155,11 +262,22 @@ _trips_destroy(_trip_stream_t *s)
     {
         n = m->next;
 
+        if (m->release)
+        {
+            m->release((trip_stream_t *)s, TRIPM_KILL, m->ctx);
+        }
+
         //s->message_cb((trip_stream_t *)s, TRIPM_KILL, m->len, m->buf);
         _tripc_free_message(s->connection, m);
 
         m = n;
     }
+
+    if (s->fec)
+    {
+        fec_destroy(s->fec);
+        s->fec = tripm_cfree(s->fec);
+    }
 }
 
 /* STREAM PUBLIC */
@@ -185,7 +303,14 @@ enum trip_stream_status
 trips_status(trip_stream_t *_s)
 {
     trip_tostream(s, _s);
-    return s->status;
+    return (enum trip_stream_status)s->status;
+}
+
+int
+trips_priority(trip_stream_t *_s)
+{
+    trip_tostream(s, _s);
+    return s->priority;
 }
 
 int
@@ -213,8 +338,262 @@ trips_close(trip_stream_t *_s)
     }
 }
 
+/**
+ * @brief Send a repair segment after every k data segments.
+ *
+ * A lost segment is rebuilt from the rest of its group instead of
+ * waiting on a retransmit. Overhead is 1/k, e.g. k = 10 for 10%.
+ * @param k - Group size up to 32; zero disables.
+ * @return Zero on success; errno otherwise.
+ */
+int
+trips_set_fec(trip_stream_t *_s, int k)
+{
+    trip_tostream(s, _s);
+
+    if (k < 0 || k > _TRIP_FEC_MAX_K)
+    {
+        return EINVAL;
+    }
+
+    if (!s->connection)
+    {
+        return ENOTCONN;
+    }
+
+    if (s->fec)
+    {
+        fec_destroy(s->fec);
+        s->fec = tripm_cfree(s->fec);
+    }
+
+    if (!k)
+    {
+        return 0;
+    }
+
+    fec_t *f = tripm_alloc(sizeof(fec_t));
+
+    if (!f)
+    {
+        return ENOMEM;
+    }
+
+    int code = fec_init(f, (uint32_t)k, s->connection->router->buflen);
+
+    if (code)
+    {
+        tripm_free(f);
+        return code;
+    }
+
+    s->fec = f;
+
+    return 0;
+}
+
+/**
+ * @brief Check that a message of the given length may be queued.
+ * @return Zero if the message may be sent; error otherwise.
+ */
+static int
+_trips_check_send(_trip_stream_t *s, size_t len)
+{
+    if (!s->connection)
+    {
+        return ENOTCONN;
+    }
+
+    if (!len || len > INT_MAX || len > s->connection->cold->peer.lim.message_size)
+    {
+        return EINVAL;
+    }
+
+    if (s->flags & _TRIPS_OPT_CLOSED)
+    {
+        return ESHUTDOWN;
+    }
+
+    if (s->flags & (_TRIPS_OPT_BACKFLOW | _TRIPS_OPT_STALLED))
+    {
+        return EWOULDBLOCK;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Hand a send to the router thread; the iovec array is copied.
+ * @return Zero if queued; error otherwise.
+ */
+static int
+_trips_submit(const trip_streamref_t *ref, enum _trip_submit_kind kind,
+              size_t len, const unsigned char *buf, const struct iovec *iov,
+              int iovcnt, trip_handle_release_t *release, void *ctx)
+{
+    size_t iovlen = sizeof(struct iovec) * (size_t)iovcnt;
+    _trip_submit_t *sub = tripm_alloc(sizeof(_trip_submit_t) + iovlen);
+
+    if (!sub)
+    {
+        return ENOMEM;
+    }
+
+    memset(sub, 0, sizeof(_trip_submit_t));
+    sub->kind = kind;
+    sub->ref = *ref;
+    sub->len = len;
+    sub->buf = buf;
+    if (iovcnt)
+    {
+        sub->iov = (struct iovec *)(sub + 1);
+        memcpy(sub->iov, iov, iovlen);
+    }
+    sub->iovcnt = iovcnt;
+    sub->release = release;
+    sub->ctx = ctx;
+
+    trip_torouter(r, ref->router);
+
+    int code = _trip_submit(r, sub);
+    if (code)
+    {
+        tripm_free(sub);
+    }
+
+    return code;
+}
+
+/**
+ * @brief Check a gather list.
+ * @return Zero and the total length in len; EINVAL if malformed.
+ */
+static int
+_trips_check_iov(const struct iovec *iov, int iovcnt, size_t *len)
+{
+    if (!iov || iovcnt <= 0 || iovcnt > _TRIP_MSG_MAX_IOV)
+    {
+        return EINVAL;
+    }
+
+    *len = 0;
+    int i;
+    for (i = 0; i < iovcnt; ++i)
+    {
+        if (!iov[i].iov_base && iov[i].iov_len)
+        {
+            return EINVAL;
+        }
+        *len += iov[i].iov_len;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Swap user data between messages.
+ */
+static void
+_trips_msg_swap(_trip_msg_t *a, _trip_msg_t *b)
+{
+    _trip_msg_t t = *a;
+
+    a->len = b->len;
+    a->buf = b->buf;
+    a->iov = b->iov;
+    a->iovcnt = b->iovcnt;
+    a->release = b->release;
+    a->ctx = b->ctx;
+    a->seq = b->seq;
+
+    b->len = t.len;
+    b->buf = t.buf;
+    b->iov = t.iov;
+    b->iovcnt = t.iovcnt;
+    b->release = t.release;
+    b->ctx = t.ctx;
+    b->seq = t.seq;
+}
+
+/**
+ * @brief Apply backflow once queued data reaches the high-water mark.
+ */
+static void
+_trips_check_backflow(_trip_stream_t *s)
+{
+    if (s->qlen >= s->connection->router->stream_hiwat)
+    {
+        s->flags |= _TRIPS_OPT_BACKFLOW;
+    }
+}
+
+/**
+ * @brief Replace the queued message if none of it has been sent yet.
+ *
+ * The message keeps its place in the queues, only the data is swapped.
+ * @return True if superseded, the new message struct is released.
+ */
+static bool
+_trips_supersede(_trip_stream_t *s, _trip_msg_t *m)
+{
+    _trip_msg_t *q = s->sendend;
+
+    if (!q || q->off)
+    {
+        return false;
+    }
+
+    s->qlen -= q->len;
+    s->qlen += m->len;
+
+    _trips_msg_swap(q, m);
+
+    if (m->release)
+    {
+        m->release((trip_stream_t *)s, TRIPM_KILL, m->ctx);
+    }
+
+    _tripc_free_message(s->connection, m);
+
+    /* The replacement may take the queue past either mark. */
+    _trips_check_backflow(s);
+    _trips_check_writable(s);
+
+    return true;
+}
+
+/**
+ * @brief Queue the filled out message and apply backflow.
+ */
+static void
+_trips_enqueue(_trip_stream_t *s, _trip_msg_t *m)
+{
+    m->off = 0;
+    m->seq = s->sendseq++;
+
+    if ((s->flags & TRIPS_OPT_LATEST) && _trips_supersede(s, m))
+    {
+        return;
+    }
+
+    m->stream = s;
+    m->next = NULL;
+    m->parts = NULL;
+
+    _tripc_send_add(s->connection, m);
+    _trips_msg_add(s, m);
+
+    s->qlen += m->len;
+    _trips_check_backflow(s);
+}
+
 /**
  * @brief Send a message on the stream.
+ *
+ * May be called from any thread while the handle is valid. Off the router
+ * thread the message is queued for the router and errors found there are
+ * not reported; use trips_sendv to learn the outcome. A thread that cannot
+ * know whether the stream has closed should send through trips_ref.
  * @return Zero on success in passing to framework; error otherwise.
  */
 int
@@ -226,31 +605,96 @@ trips_send(trip_stream_t *_s, size_t len, const unsigned char *buf)
 
     do
     {
-        if (!s->connection)
+        if (!buf)
         {
-            code = ENOTCONN;
+            code = EINVAL;
             break;
         }
 
-        if (!buf || !len || len > INT_MAX || len > s->connection->peer.lim.message_size)
+        if (!_trip_is_owner(s->connection->router))
         {
-            code = EINVAL;
+            trip_streamref_t ref = _trips_ref(s);
+            code = _trips_submit(&ref, _TRIP_SUBMIT_SEND, len, buf,
+                                 NULL, 0, NULL, NULL);
             break;
         }
 
-        if (s->flags & _TRIPS_OPT_CLOSED)
+        code = _trips_check_send(s, len);
+        if (code)
         {
-            code = ESHUTDOWN;
             break;
         }
 
-        if (s->flags & (_TRIPS_OPT_BACKFLOW | _TRIPS_OPT_STALLED))
+        _trip_msg_t *m = _tripc_new_message(s->connection);
+        
+        if (!m)
         {
-            code = EWOULDBLOCK;
+            code = ENOMEM;
             break;
         }
 
-        _trip_msg_t *m = _tripc_new_message(s->connection);
+        m->len = len;
+        m->buf = buf;
+        m->iov = NULL;
+        m->iovcnt = 0;
+        m->release = NULL;
+        m->ctx = NULL;
+
+        _trips_enqueue(s, m);
+    } while (false);
+
+    return code;
+}
+
+/**
+ * @brief Send one message gathered from the buffers without copying them.
+ *
+ * The iovec array is copied, the buffers it points to are borrowed.
+ * The release callback is called once the buffers are no longer needed:
+ * TRIPM_SENT when the message is done, see _trips_done_message,
+ * TRIPM_KILL if the message is abandoned.
+ * @note Nothing packs DATA segments yet (_tripc_send_data), so until it
+ * does TRIPM_SENT is never delivered; buffers come back with TRIPM_KILL
+ * when the stream closes or a latest-value send supersedes them.
+ * From another thread the message is queued for the router thread, and
+ * if it is refused there release gets TRIPM_KILL, with a NULL stream if
+ * the stream is gone. The handle must still be valid when called; see
+ * trips_sendv_ref otherwise.
+ * @return Zero on success in passing to framework; error otherwise.
+ */
+int
+trips_sendv(trip_stream_t *_s, const struct iovec *iov, int iovcnt,
+            trip_handle_release_t *release, void *ctx)
+{
+    trip_tostream(s, _s);
+
+    int code = 0;
+    _trip_msg_t *m = NULL;
+
+    do
+    {
+        size_t len = 0;
+        code = _trips_check_iov(iov, iovcnt, &len);
+        if (code)
+        {
+            break;
+        }
+
+        if (!_trip_is_owner(s->connection->router))
+        {
+            trip_streamref_t ref = _trips_ref(s);
+            code = _trips_submit(&ref, _TRIP_SUBMIT_SENDV, len, NULL,
+                                 iov, iovcnt, release, ctx);
+            break;
+        }
+
+        code = _trips_check_send(s, len);
+        if (code)
+        {
+            break;
+        }
+
+        m = _tripc_new_message(s->connection);
         
         if (!m)
         {
@@ -258,17 +702,114 @@ trips_send(trip_stream_t *_s, size_t len, const unsigned char *buf)
             break;
         }
 
-        m->stream = s;
-        m->next = NULL;
-        m->priority = _trips_priority(s);
+        m->iov = tripm_alloc(sizeof(struct iovec) * iovcnt);
+
+        if (!m->iov)
+        {
+            code = ENOMEM;
+            break;
+        }
+
+        memcpy(m->iov, iov, sizeof(struct iovec) * iovcnt);
+        m->iovcnt = iovcnt;
         m->len = len;
-        m->buf = buf;
-        m->parts = NULL;
+        m->buf = NULL;
+        m->release = release;
+        m->ctx = ctx;
 
-        _tripc_send_add(s->connection, m);
-        _trips_msg_add(s, m);
+        _trips_enqueue(s, m);
     } while (false);
 
+    if (code && m)
+    {
+        _tripc_free_message(s->connection, m);
+    }
+
     return code;
 }
 
+/**
+ * @brief Router thread. Capture a reference to the stream.
+ *
+ * The reference stays safe to use from any thread after the stream is
+ * freed; it only ever resolves to the stream it was taken from.
+ */
+trip_streamref_t
+trips_ref(trip_stream_t *_s)
+{
+    trip_tostream(s, _s);
+    return _trips_ref(s);
+}
+
+/**
+ * @brief Any thread. Send a message on the referenced stream.
+ *
+ * Like trips_send, but nothing of the stream is touched off the router
+ * thread; it is looked up there and the send dropped if it closed.
+ * @return Zero on success in passing to framework; error otherwise.
+ */
+int
+trips_send_ref(const trip_streamref_t *ref, size_t len, const unsigned char *buf)
+{
+    if (!ref || !ref->router || !buf)
+    {
+        return EINVAL;
+    }
+
+    trip_torouter(r, ref->router);
+
+    if (!_trip_is_owner(r))
+    {
+        return _trips_submit(ref, _TRIP_SUBMIT_SEND, len, buf, NULL, 0,
+                             NULL, NULL);
+    }
+
+    _trip_stream_t *s = _trips_resolve(r, ref);
+    if (!s)
+    {
+        return ENOTCONN;
+    }
+
+    return trips_send((trip_stream_t *)s, len, buf);
+}
+
+/**
+ * @brief Any thread. Send a gathered message on the referenced stream.
+ *
+ * Like trips_sendv, but nothing of the stream is touched off the router
+ * thread. If the stream closed before the router thread got to the send
+ * release gets TRIPM_KILL with a NULL stream.
+ * @return Zero on success in passing to framework; error otherwise.
+ */
+int
+trips_sendv_ref(const trip_streamref_t *ref, const struct iovec *iov,
+                int iovcnt, trip_handle_release_t *release, void *ctx)
+{
+    if (!ref || !ref->router)
+    {
+        return EINVAL;
+    }
+
+    size_t len = 0;
+    int code = _trips_check_iov(iov, iovcnt, &len);
+    if (code)
+    {
+        return code;
+    }
+
+    trip_torouter(r, ref->router);
+
+    if (!_trip_is_owner(r))
+    {
+        return _trips_submit(ref, _TRIP_SUBMIT_SENDV, len, NULL, iov, iovcnt,
+                             release, ctx);
+    }
+
+    _trip_stream_t *s = _trips_resolve(r, ref);
+    if (!s)
+    {
+        return ENOTCONN;
+    }
+
+    return trips_sendv((trip_stream_t *)s, iov, iovcnt, release, ctx);
+}
@@ -33,37 +33,85 @@ extern "C" {
 #include "libtrp.h"
 
 #include "core.h"
+#include "fec.h"
 #include "message.h"
 
 
 /* First options/flags are set by the user.
  * Remaining flags are set internally and used by the framework.
  */
-#define _TRIPS_OPT_BACKFLOW (1 << 4)
-#define _TRIPS_OPT_CLOSED   (1 << 5)
-#define _TRIPS_OPT_STALLED  (1 << 6)
-#define _TRIPS_OPT_PUBMASK (0x000F)
-#define _TRIPS_OPT_SECMASK (0x007F)
+#define _TRIPS_OPT_BACKFLOW (1 << 5)
+#define _TRIPS_OPT_CLOSED   (1 << 6)
+#define _TRIPS_OPT_STALLED  (1 << 7)
+#define _TRIPS_OPT_PUBMASK (0x001F)
+#define _TRIPS_OPT_SECMASK (0x00FF)
+
+/* Priority of streams opened by the peer until the user changes it. */
+#define _TRIPS_DEFAULT_PRIORITY (TRIPS_PRIORITY_LEVELS / 2)
 
 // TODO idea for stream message lookup is to store in n x m array
 // TODO n long and m max messages linked per entry grow array by one
 // TODO attackers would need number that hashes perfectly and growing
 // TODO will throw clustering off
+/* Packed so several fit inline in a connection, see _TRIPC_INLINE_STREAMS;
+ * small fields are narrowed and grouped to leave no holes.
+ */
 struct _trip_stream_s
 {
     /* Frequently Accessed */
     void *data;
     _trip_connection_t *connection;
-
-    int id;
-    enum trip_connection_status status;
-    int type;
-    int flags;
     _trip_msg_t *listbeg;
     _trip_msg_t *listend;
+
+    int id;
+    /* enum trip_stream_status */
+    uint8_t status;
+    uint8_t type;
+    /* Within _TRIPS_OPT_SECMASK. */
+    uint8_t flags;
+
+    /* Send scheduling, see messageq_t. */
+    uint8_t priority;
+    bool inq;
+
+    /* Latest-value streams deliver only messages newer than recvseq. */
+    bool hasrecv;
+    /* Stream message sequences. */
+    uint32_t sendseq;
+    uint32_t recvseq;
+
+    _trip_stream_t *qnext;
+    _trip_msg_t *sendbeg;
+    _trip_msg_t *sendend;
+
+    /* Forward error correction, NULL if disabled. */
+    fec_t *fec;
+
+    /* Bytes queued and not yet done sending.
+     * Backflow is set at the high-water mark and lifted at the low.
+     */
+    size_t qlen;
+
+    /* Handed out at open; trips_ref pairs it with the IDs so a reference
+     * never resolves to a later stream under the same IDs.
+     */
+    uint64_t gen;
 };
 
 
+void
+_trips_init(_trip_stream_t *s, _trip_connection_t *c, int sid, int priority, int options);
+void
+_trips_destroy(_trip_stream_t *s);
+_trip_stream_t *
+_trips_resolve(_trip_router_t *r, const trip_streamref_t *ref);
+void
+_trips_done_message(_trip_stream_t *s, _trip_msg_t *m);
+void
+_trips_message(_trip_stream_t *s, uint32_t seq, size_t len, unsigned char *buf);
+
+
 #ifdef __cplusplus
 }
 #endif
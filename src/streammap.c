@@ -1,19 +1,44 @@
 
+
 #include "streammap.h"
 
 #include <errno.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "util.h"
 
 
 
+/**
+ * Resize to exactly cap slots; new slots are empty.
+ */
+static int
+streammap_resize(streammap_t *map, uint32_t cap)
+{
+    _trip_stream_t **m = realloc(map->map, sizeof(_trip_stream_t *) * cap);
+
+    if (!m)
+    {
+        return ENOMEM;
+    }
+
+    if (cap > map->cap)
+    {
+        memset(&m[map->cap], 0, sizeof(_trip_stream_t *) * (cap - map->cap));
+    }
+
+    map->map = m;
+    map->cap = (uint16_t)cap;
+
+    return 0;
+}
+
 void
-streammap_init(streammap_t *map, int max)
+streammap_init(streammap_t *map)
 {
     *map = (streammap_t){ 0 };
-    map->cap = max;
 }
 
 void
@@ -22,113 +47,241 @@ streammap_destroy(streammap_t *map)
     if (map->map)
     {
         free(map->map);
-        *map = (streammap_t){ 0 };
     }
+
+    if (map->sparse)
+    {
+        free(map->sparse);
+    }
+
+    *map = (streammap_t){ 0 };
 }
 
-int
-streammap_iter_beg(streammap_t * UNUSED(map))
+/**
+ * Any stream in the map, the highest ID first, for tearing it down.
+ * @return NULL if empty.
+ */
+_trip_stream_t *
+streammap_last(streammap_t *map)
 {
-    return 0;
+    if (map->sparse)
+    {
+        return map->sparse->s[map->sparse->size - 1];
+    }
+
+    if (map->top)
+    {
+        return map->map[map->top - 1];
+    }
+
+    return NULL;
 }
 
-int
-streammap_iter_end(streammap_t *map)
+/**
+ * Binary search of the sparse array.
+ * @return Position of the ID, or where it would be inserted.
+ */
+static uint32_t
+streammap_sparse_find(const streamsparse_t *sp, uint32_t index)
 {
-    return map->cap;
+    uint32_t lo = 0;
+    uint32_t hi = sp->size;
+
+    while (lo < hi)
+    {
+        uint32_t mid = lo + (hi - lo) / 2;
+
+        if ((uint32_t)sp->s[mid]->id < index)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    return lo;
 }
 
-bool
-streammap_has_space(streammap_t *map)
+_trip_stream_t *
+streammap_sparse_get(streammap_t *map, uint32_t index)
 {
-    return map->size < map->cap;
+    streamsparse_t *sp = map->sparse;
+    uint32_t i = streammap_sparse_find(sp, index);
+
+    if (i < sp->size && (uint32_t)sp->s[i]->id == index)
+    {
+        return sp->s[i];
+    }
+
+    return NULL;
 }
 
-int
-streammap_add(streammap_t *map, _trip_stream_t *s)
+static int
+streammap_sparse_add(streammap_t *map, _trip_stream_t *s)
 {
-    int code = 0;
+    uint32_t index = (uint32_t)s->id;
+    streamsparse_t *sp = map->sparse;
+    uint32_t i = 0;
 
-    do
+    if (sp)
     {
-        if (!map->free)
-        {
-            int max = map->cap;
+        i = streammap_sparse_find(sp, index);
 
-            void *m = malloc(sizeof(_trip_stream_t *) * max);
+        if (i < sp->size && (uint32_t)sp->s[i]->id == index)
+        {
+            return EEXIST;
+        }
+    }
 
-            if (!m)
-            {
-                code = ENOMEM;
-                break;
-            }
+    if (!sp || sp->size == sp->cap)
+    {
+        uint32_t cap = sp ? sp->cap * 2 : _STREAMMAP_MIN_CAP;
+        streamsparse_t *n = realloc(sp, sizeof(streamsparse_t)
+                                        + sizeof(_trip_stream_t *) * cap);
 
-            map->map = m;
+        if (!n)
+        {
+            return ENOMEM;
+        }
 
-            int i = 0;
-            map->cap = map->cap * 2;
-            map->free = &map->map[i];
-            for (; i < max; ++i)
-            {
-                map->map[i] = (_trip_stream_t *)&map->map[i + 1];
-            }
+        if (!sp)
+        {
+            n->size = 0;
         }
 
-        /* There are free slots. */
-        _trip_stream_t **slot = map->free;
-        /* Advance free slot. */
-        map->free = *((_trip_stream_t **)map->free);
-        /* Set index. */
-        int index = (int)((slot) - map->map);
-        s->id = index;
-        *slot = s;
-        /* Increment size. */
-        ++map->size;
-    } while (false);
-
-    return code;
+        n->cap = cap;
+        map->sparse = sp = n;
+    }
+
+    memmove(&sp->s[i + 1], &sp->s[i], sizeof(_trip_stream_t *) * (sp->size - i));
+    sp->s[i] = s;
+    ++sp->size;
+    ++map->size;
+
+    return 0;
 }
 
-_trip_stream_t *
-streammap_del(streammap_t *map, int index)
+static _trip_stream_t *
+streammap_sparse_del(streammap_t *map, uint32_t index)
 {
-    if (LIKELY(index < map->cap))
+    streamsparse_t *sp = map->sparse;
+
+    if (!sp)
     {
-        _trip_stream_t *s = map->map[index];
-        _trip_stream_t **slot = &map->map[index];
-        if (map->free)
-        {
-            *slot = (_trip_stream_t *)map->free;
-        }
-        else
+        return NULL;
+    }
+
+    uint32_t i = streammap_sparse_find(sp, index);
+
+    if (i >= sp->size || (uint32_t)sp->s[i]->id != index)
+    {
+        return NULL;
+    }
+
+    _trip_stream_t *s = sp->s[i];
+
+    --sp->size;
+    --map->size;
+    memmove(&sp->s[i], &sp->s[i + 1], sizeof(_trip_stream_t *) * (sp->size - i));
+
+    if (!sp->size)
+    {
+        free(sp);
+        map->sparse = NULL;
+    }
+
+    return s;
+}
+
+/**
+ * Place the stream at its ID.
+ * @return Zero on success; ERANGE if the ID is negative, EEXIST if taken,
+ * or ENOMEM.
+ */
+int
+streammap_add(streammap_t *map, _trip_stream_t *s)
+{
+    if (s->id < 0)
+    {
+        return ERANGE;
+    }
+
+    uint32_t index = (uint32_t)s->id;
+
+    if (index >= _STREAMMAP_DENSE_MAX)
+    {
+        return streammap_sparse_add(map, s);
+    }
+
+    if (index >= map->cap)
+    {
+        uint32_t cap = map->cap ? map->cap : _STREAMMAP_MIN_CAP;
+
+        while (cap <= index)
         {
-            *slot = NULL;
+            cap *= 2;
         }
 
-        map->free = (void *)slot;
-        --map->size;
+        int code = streammap_resize(map, cap);
 
-        if (!map->size)
+        if (code)
         {
-            free(map->map);
-            map->map = NULL;
+            return code;
         }
+    }
 
-        return s;
+    if (map->map[index])
+    {
+        return EEXIST;
     }
 
-    return NULL;
+    map->map[index] = s;
+    ++map->size;
+
+    if (index >= map->top)
+    {
+        map->top = (uint16_t)(index + 1);
+    }
+
+    return 0;
 }
 
 _trip_stream_t *
-streammap_get(streammap_t *map, int index)
+streammap_del(streammap_t *map, int index)
 {
-    if (LIKELY(index < map->cap))
+    if (UNLIKELY((uint32_t)index >= map->cap))
+    {
+        if ((uint32_t)index >= _STREAMMAP_DENSE_MAX)
+        {
+            return streammap_sparse_del(map, (uint32_t)index);
+        }
+
+        return NULL;
+    }
+
+    _trip_stream_t *s = map->map[index];
+
+    if (!s)
     {
-        _trip_stream_t *s = map->map[index];
-        return s;
+        return NULL;
     }
 
-    return NULL;
-}
+    map->map[index] = NULL;
+    --map->size;
 
+    while (map->top && !map->map[map->top - 1])
+    {
+        --map->top;
+    }
+
+    /* Hysteresis: only shrink once well under half, and keep the minimum. */
+    if (map->cap > _STREAMMAP_MIN_CAP && map->top <= map->cap / 4)
+    {
+        /* A failed shrink leaves the larger array in place. */
+        streammap_resize(map, map->cap / 2);
+    }
+
+    return s;
+}
@@ -37,35 +37,53 @@ extern "C" {
 #include "stream.h"
 
 
+/* Smallest allocation; never shrunk below this. */
+#define _STREAMMAP_MIN_CAP (8)
+/* The dense array never grows past this many slots; IDs at or above it are
+ * kept sorted in the sparse array, so a peer naming a high ID cannot make
+ * the connection allocate a slot for every ID below it.
+ */
+#define _STREAMMAP_DENSE_MAX (1024)
+
 /**
- * Static array.
+ * Streams with IDs of _STREAMMAP_DENSE_MAX and up, sorted by ID.
+ */
+typedef struct streamsparse_s
+{
+    uint32_t size;
+    uint32_t cap;
+    _trip_stream_t *s[];
+} streamsparse_t;
+
+/**
+ * Dense array indexed by stream ID, with a sorted sparse array for high IDs.
+ * Grows by doubling up to _STREAMMAP_DENSE_MAX; shrinks by half once the
+ * highest ID in use falls to a quarter of capacity, so open/close cycles
+ * don't thrash. Limits on IDs are the connection's to enforce, each side
+ * has its own, see _tripc_get_stream and tripc_open_stream.
  */
 typedef struct streammap_s
 {
-    /* Size of the map. */
-    int size;
-    /* Capacity of the map. */
-    int cap;
+    /* Number of streams in the map. */
+    uint32_t size;
+    /* Allocated slots. */
+    uint16_t cap;
+    /* One past the highest dense ID in use. */
+    uint16_t top;
     /* Map. NULL if not allocated. */
     _trip_stream_t **map;
-    /* Empty slot list. */
-    void *free;
+    /* NULL if no high IDs are in use. */
+    streamsparse_t *sparse;
 } streammap_t;
 
 void
-streammap_init(streammap_t *map, int max);
+streammap_init(streammap_t *map);
 
 void
 streammap_destroy(streammap_t *map);
 
-int
-streammap_iter_beg(streammap_t *map);
-
-int
-streammap_iter_end(streammap_t *map);
-
-bool
-streammap_has_space(streammap_t *map);
+_trip_stream_t *
+streammap_last(streammap_t *map);
 
 int
 streammap_add(streammap_t *map, _trip_stream_t *s);
@@ -74,7 +92,28 @@ _trip_stream_t *
 streammap_del(streammap_t *map, int index);
 
 _trip_stream_t *
-streammap_get(streammap_t *map, int index);
+streammap_sparse_get(streammap_t *map, uint32_t index);
+
+/**
+ * Every DATA frame looks up its stream here.
+ * O(1) for dense IDs; high IDs take a binary search.
+ * @return NULL if no stream has the ID.
+ */
+static inline _trip_stream_t *
+streammap_get(streammap_t *map, int index)
+{
+    if ((uint32_t)index < map->cap)
+    {
+        return map->map[index];
+    }
+
+    if (map->sparse && (uint32_t)index >= _STREAMMAP_DENSE_MAX)
+    {
+        return streammap_sparse_get(map, (uint32_t)index);
+    }
+
+    return NULL;
+}
 
 
 #ifdef __cplusplus
@@ -0,0 +1,268 @@
+
+
+#include "ticket.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sodium.h>
+
+#include "libtrp_memory.h"
+#include "pack.h"
+#include "util.h"
+
+
+/**
+ * @return Bytes needed to seal the record.
+ */
+size_t
+ticket_len(const connrec_t *rec)
+{
+    return _TICKET_OVERHEAD + connrec_pack_len(rec);
+}
+
+/**
+ * Seal in place within out.
+ * @return Bytes written; NPOS if cap is too small.
+ */
+size_t
+ticket_seal(const unsigned char *key, uint64_t now, const connrec_t *rec, size_t cap, unsigned char *out)
+{
+    if (cap < ticket_len(rec))
+    {
+        return NPOS;
+    }
+
+    unsigned char *nonce = out;
+    unsigned char *box = out + crypto_secretbox_NONCEBYTES;
+    /* Plain text is written where the box starts; sodium allows overlap. */
+    unsigned char *plain = box;
+    size_t pcap = cap - crypto_secretbox_NONCEBYTES - crypto_secretbox_MACBYTES;
+
+    randombytes_buf(nonce, crypto_secretbox_NONCEBYTES);
+
+    if (NPOS == trip_pack(pcap, plain, "Q", now))
+    {
+        return NPOS;
+    }
+
+    size_t rlen = connrec_pack(rec, pcap - 8, plain + 8);
+
+    if (NPOS == rlen)
+    {
+        return NPOS;
+    }
+
+    size_t plen = 8 + rlen;
+    crypto_secretbox_easy(box, plain, plen, nonce, key);
+
+    return crypto_secretbox_NONCEBYTES + crypto_secretbox_MACBYTES + plen;
+}
+
+/**
+ * Verify, check the time window, and unpack the record.
+ * @param tag - Set for the replay filter.
+ * @param issued - Set for the replay filter.
+ * @return Zero on success; EINVAL if forged or malformed, ETIME if expired,
+ * or ENOMEM.
+ */
+int
+ticket_open(const unsigned char *key, uint64_t now, uint64_t lifems, size_t len, const unsigned char *in, connrec_t *rec, uint64_t *tag, uint64_t *issued)
+{
+    if (len <= _TICKET_OVERHEAD)
+    {
+        return EINVAL;
+    }
+
+    size_t blen = len - crypto_secretbox_NONCEBYTES;
+    size_t plen = blen - crypto_secretbox_MACBYTES;
+    unsigned char *plain = tripm_alloc(plen);
+
+    if (!plain)
+    {
+        return ENOMEM;
+    }
+
+    int code = 0;
+
+    do
+    {
+        if (crypto_secretbox_open_easy(plain, in + crypto_secretbox_NONCEBYTES, blen, in, key))
+        {
+            code = EINVAL;
+            break;
+        }
+
+        uint64_t stamp = 0;
+        trip_unpack(plen, plain, "Q", &stamp);
+
+        if (stamp > now || now - stamp > lifems)
+        {
+            code = ETIME;
+            break;
+        }
+
+        if (NPOS == connrec_unpack(rec, plen - 8, plain + 8))
+        {
+            code = EINVAL;
+            break;
+        }
+
+        memcpy(tag, in, sizeof(*tag));
+        *issued = stamp;
+    } while (false);
+
+    sodium_memzero(plain, plen);
+    tripm_free(plain);
+
+    return code;
+}
+
+/**
+ * One labelled output keyed by the ticket secret.
+ */
+static void
+ticket_kdf(const unsigned char *secret, const unsigned char *salt, uint8_t label, size_t len, unsigned char *out)
+{
+    unsigned char in[1 + _TRIP_NONCE];
+
+    in[0] = label;
+    memcpy(in + 1, salt, _TRIP_NONCE);
+    crypto_generichash(out, len, in, sizeof(in), secret, _TICKET_SECRET);
+}
+
+/**
+ * Derive the RESUME tag and both sides' keys from the ticket secret and
+ * the client's salt. A fresh salt gives a fresh generation.
+ */
+void
+ticket_derive(const unsigned char *secret, const unsigned char *salt, ticketkeys_t *keys)
+{
+    unsigned char seed[crypto_box_SEEDBYTES];
+    size_t i = 0;
+
+    ticket_kdf(secret, salt, 'T', _TICKET_TAG, keys->tag);
+
+    for (; i < 2; ++i)
+    {
+        ticket_kdf(secret, salt, (uint8_t)('K' + i), sizeof(seed), seed);
+        crypto_box_seed_keypair(keys->pk[i], keys->sk[i], seed);
+        ticket_kdf(secret, salt, (uint8_t)('N' + i), _TRIP_NONCE, keys->nonce[i]);
+    }
+
+    sodium_memzero(seed, sizeof(seed));
+}
+
+void
+ticketreplay_init(ticketreplay_t *t)
+{
+    memset(t, 0, sizeof(ticketreplay_t));
+}
+
+void
+ticketreplay_destroy(ticketreplay_t *t)
+{
+    tripm_cfree(t->gen[0].tag);
+    tripm_cfree(t->gen[1].tag);
+    ticketreplay_init(t);
+}
+
+/**
+ * @return Slot holding tag, or the empty slot it belongs in.
+ */
+static size_t
+ticketgen_find(const ticketgen_t *g, uint64_t tag)
+{
+    size_t mask = g->cap - 1;
+    size_t index = (size_t)tag & mask;
+
+    while (g->tag[index] && g->tag[index] != tag)
+    {
+        index = (index + 1) & mask;
+    }
+
+    return index;
+}
+
+/**
+ * Double the table so it stays at most half full.
+ * @return Zero on success; ENOMEM otherwise.
+ */
+static int
+ticketgen_grow(ticketgen_t *g)
+{
+    size_t cap = g->cap ? g->cap * 2 : _TICKET_REPLAY;
+    uint64_t *tags = tripm_alloc(sizeof(uint64_t) * cap);
+
+    if (!tags)
+    {
+        return ENOMEM;
+    }
+
+    memset(tags, 0, sizeof(uint64_t) * cap);
+
+    ticketgen_t next = { g->epoch, g->size, cap, tags };
+    size_t i = 0;
+
+    for (; i < g->cap; ++i)
+    {
+        if (g->tag[i])
+        {
+            next.tag[ticketgen_find(&next, g->tag[i])] = g->tag[i];
+        }
+    }
+
+    tripm_cfree(g->tag);
+    *g = next;
+
+    return 0;
+}
+
+/**
+ * Remember a redeemed ticket for as long as it could be presented again.
+ * Call only after ticket_open passed, so issued is within the lifetime.
+ * @return Zero on success; EALREADY if redeemed before; ENOMEM otherwise.
+ */
+int
+ticketreplay_add(ticketreplay_t *t, uint64_t tag, uint64_t issued, uint64_t lifems)
+{
+    uint64_t epoch = issued / (lifems ? lifems : 1);
+    ticketgen_t *g = &t->gen[epoch & 1];
+
+    /* Zero marks empty; a tag is random so this only shifts one value. */
+    tag = tag ? tag : 1;
+
+    if (g->epoch != epoch)
+    {
+        if (g->epoch > epoch && g->tag)
+        {
+            /* Two epochs old, long expired. */
+            return EALREADY;
+        }
+
+        /* Everything from two epochs back has expired. */
+        if (g->tag)
+        {
+            memset(g->tag, 0, sizeof(uint64_t) * g->cap);
+        }
+
+        g->epoch = epoch;
+        g->size = 0;
+    }
+
+    if ((g->size + 1) * 2 > g->cap && ticketgen_grow(g))
+    {
+        return ENOMEM;
+    }
+
+    size_t index = ticketgen_find(g, tag);
+
+    if (g->tag[index])
+    {
+        return EALREADY;
+    }
+
+    g->tag[index] = tag;
+    ++g->size;
+
+    return 0;
+}
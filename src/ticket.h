@@ -0,0 +1,127 @@
+/*******************************************************************************
+ * Copyright (c) 2019 Craig Jacobson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+/**
+ * @file ticket.h
+ * @author Craig Jacobson
+ * @brief Resumption tickets.
+ *
+ * A server seals its side of a ready connection under a router secret and
+ * hands it to the client along with a fresh ticket secret. A returning
+ * client presents it with RESUME and the server rebuilds the connection
+ * without OPEN/CHAL/PING or a key exchange.
+ *
+ * The ticket's keys have already sealed packets, so neither side uses
+ * them again: both derive a new generation from the ticket secret and a
+ * salt the client picks for the RESUME, see ticket_derive.
+ *
+ * | Octets | Field |
+ * |:------ |:----- |
+ * | 24 | Nonce
+ * | 16 | MAC
+ * | 8 | Issued timestamp
+ * | VD | Packed connrec_t
+ */
+#ifndef _LIBTRP_TICKET_H_
+#define _LIBTRP_TICKET_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "connrec.h"
+#include "crypto.h"
+
+
+#define _TICKET_KEY (crypto_secretbox_KEYBYTES)
+#define _TICKET_OVERHEAD (crypto_secretbox_NONCEBYTES + crypto_secretbox_MACBYTES + 8)
+/* Initial slots of a replay generation; grows to stay at most half full. */
+#define _TICKET_REPLAY (64)
+/* Shared by the server's record and the client. */
+#define _TICKET_SECRET (crypto_generichash_KEYBYTES)
+/* Proves the RESUME salt came from the ticket's holder. */
+#define _TICKET_TAG (crypto_generichash_BYTES)
+
+/**
+ * Redeemed tickets issued in one epoch, an open addressed set of tags.
+ * Zero marks an empty slot.
+ */
+typedef struct ticketgen_s
+{
+    uint64_t epoch;
+    size_t size;
+    size_t cap;
+    uint64_t *tag;
+} ticketgen_t;
+
+/**
+ * Tickets are single use within their lifetime.
+ * An epoch is one ticket lifetime by issue time. A ticket still valid was
+ * issued this epoch or the last, so two generations cover every one that
+ * can be redeemed and the older is dropped whole as epochs pass. Each
+ * grows with the redeem rate rather than rejecting once full.
+ */
+typedef struct ticketreplay_s
+{
+    ticketgen_t gen[2];
+} ticketreplay_t;
+
+/**
+ * Keys of a resumed connection; index 0 is the client's, 1 the server's.
+ */
+typedef struct ticketkeys_s
+{
+    unsigned char tag[_TICKET_TAG];
+    unsigned char pk[2][TRIP_KEY_PUB];
+    unsigned char sk[2][TRIP_KEY_SEC];
+    unsigned char nonce[2][_TRIP_NONCE];
+} ticketkeys_t;
+
+size_t
+ticket_len(const connrec_t *rec);
+
+size_t
+ticket_seal(const unsigned char *key, uint64_t now, const connrec_t *rec, size_t cap, unsigned char *out);
+
+int
+ticket_open(const unsigned char *key, uint64_t now, uint64_t lifems, size_t len, const unsigned char *in, connrec_t *rec, uint64_t *tag, uint64_t *issued);
+
+void
+ticket_derive(const unsigned char *secret, const unsigned char *salt, ticketkeys_t *keys);
+
+void
+ticketreplay_init(ticketreplay_t *t);
+
+void
+ticketreplay_destroy(ticketreplay_t *t);
+
+int
+ticketreplay_add(ticketreplay_t *t, uint64_t tag, uint64_t issued, uint64_t lifems);
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _LIBTRP_TICKET_H_ */
@@ -63,3 +63,17 @@ triptime_timeout(uint64_t deadline, uint64_t now)
     return timeout;
 }
 
+/**
+ * @brief Monotonic microseconds, for spinning; not comparable to triptime_now.
+ */
+uint64_t
+triptime_now_us(void)
+{
+    struct timespec t;
+    if (clock_gettime(CLOCK_MONOTONIC, &t) < 0)
+    {
+        return 0;
+    }
+    uint64_t n = ((uint64_t)t.tv_sec * 1000000) + (t.tv_nsec/1000);
+    return n;
+}
@@ -43,6 +43,8 @@ uint64_t
 triptime_deadline(int);
 int
 triptime_timeout(uint64_t, uint64_t);
+uint64_t
+triptime_now_us(void);
 
 
 
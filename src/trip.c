@@ -40,8 +40,14 @@
 #include "util.h"
 
 #include <errno.h>
+#include <fcntl.h>
 #include <stdarg.h>
+#include <stdio.h>
 #include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 
 #define DEBUG_ROUTER (1)
@@ -72,10 +78,24 @@ _trip_screen_init(trip_screen_t *screen)
     memset(screen, 0, sizeof(trip_screen_t));
 }
 
+/**
+ * The cold part shares the allocation, after the aligned hot part.
+ */
 _trip_connection_t *
 _trip_new_connection()
 {
-    return tripm_alloc(sizeof(_trip_connection_t));
+    void *p = NULL;
+
+    if (tripm_memalign(&p, CACHE_LINE,
+                       sizeof(_trip_connection_t) + sizeof(_trip_connection_cold_t)))
+    {
+        return NULL;
+    }
+
+    _trip_connection_t *c = p;
+    c->cold = (_trip_connection_cold_t *)(c + 1);
+
+    return c;
 }
 
 void
@@ -92,9 +112,21 @@ _trip_has_send(_trip_router_t *r)
 
 void
 _trip_listen(_trip_router_t *r, trip_socket_t fd, int events);
-
 void
-_trip_send_immediately_cb(void *_r)
+_trip_reject_connection(_trip_router_t *r, void *data, size_t ilen,
+                        unsigned char *info, int err);
+static void
+_trip_submit_run(_trip_router_t *r, _trip_submit_t *sub, bool abandon);
+static void
+_trip_keepalive_cb(void *_r);
+static void
+_trip_snapshot_cancel(_trip_router_t *r);
+
+/**
+ * The flush happens as the timeout entry point returns.
+ */
+static void
+_trip_flush_cb(void *_r)
 {
     trip_torouter(r, _r);
 
@@ -102,10 +134,78 @@ _trip_send_immediately_cb(void *_r)
     printf("%s\n", __func__);
 #endif
 
-    _trip_listen(r, TRIP_SOCKET_TIMEOUT, TRIP_INOUT);
-    if (_trip_has_send(r))
+    r->sendtimer = NULL;
+}
+
+static void
+_trip_flush_later(_trip_router_t *r, int ms)
+{
+    if (!r->sendtimer)
+    {
+        r->sendtimer = _trip_set_timeout(r, ms, r, _trip_flush_cb);
+    }
+}
+
+/**
+ * @brief Watch the send descriptor for writability, or stop.
+ */
+static void
+_trip_watch_out(_trip_router_t *r, bool out)
+{
+    int events = out ? (r->txevents | TRIP_OUT) : (r->txevents & ~TRIP_OUT);
+
+    if (events != r->txevents)
+    {
+        r->txevents = events;
+        r->watch((trip_router_t *)r, r->txfd, events,
+                 sockmap_get(&r->sockmap, r->txfd));
+    }
+}
+
+/**
+ * @brief Send what is queued, then wait on writability for what is left.
+ *
+ * Called as the outermost entry point returns. A packet left in the
+ * buffer blocked on the socket; anything else left hit the send limit.
+ * Without a descriptor to watch, a short timer polls instead.
+ */
+static void
+_trip_flush(_trip_router_t *r)
+{
+    if (_TRIPR_STATE_LISTEN != r->state && _TRIPR_STATE_CLOSE != r->state)
+    {
+        return;
+    }
+
+    if (!r->sendlen && _trip_has_send(r))
+    {
+        _trip_listen(r, TRIP_SOCKET_TIMEOUT, TRIP_OUT);
+    }
+
+    bool left = r->sendlen || _trip_has_send(r);
+
+    if (TRIP_SOCKET_TIMEOUT != r->txfd && !(r->flag & _TRIPR_FLAG_ALWAYS_READY))
     {
-        _trip_set_timeout(r, 1, r, _trip_send_immediately_cb);
+        _trip_watch_out(r, left);
+    }
+    else if (left)
+    {
+        _trip_flush_later(r, 1);
+    }
+}
+
+static void
+_trip_enter(_trip_router_t *r)
+{
+    ++r->depth;
+}
+
+static void
+_trip_leave(_trip_router_t *r)
+{
+    if (0 == --r->depth)
+    {
+        _trip_flush(r);
     }
 }
 
@@ -117,9 +217,10 @@ _trip_qconnection(_trip_router_t *r, _trip_connection_t *c)
 #endif
 
     sendq_nq(&r->sendq, c);
-    if (r->flag | _TRIPR_FLAG_ALWAYS_READY)
+    if (!r->depth)
     {
-        _trip_set_timeout(r, 0, r, _trip_send_immediately_cb);
+        /* Queued from outside the router, e.g. a user send. */
+        _trip_flush_later(r, 0);
     }
 }
 
@@ -191,6 +292,7 @@ _trip_set_timeout(_trip_router_t *r, int ms, void *data, timer_cb_t *cb)
     {
         if (e->deadline < r->mindeadline)
         {
+            r->mindeadline = e->deadline;
             r->timeout((trip_router_t *)r, (long)ms);
         }
     }
@@ -294,8 +396,10 @@ _trip_listen(_trip_router_t *r, trip_socket_t fd, int events)
                 if (EWOULDBLOCK != wcode && EAGAIN != wcode)
                 {
                     _trip_set_error(r, wcode, NULL);
-                    return;
                 }
+
+                /* Buffer still holds the packet, try again later. */
+                return;
             }
             else
             {
@@ -306,73 +410,67 @@ _trip_listen(_trip_router_t *r, trip_socket_t fd, int events)
         }
 
         /* Rate limit number of sent packets.
-         * Each connection gets to send a certain amount of
-         * sequential packets.
-         * After blocking the connection is requeued.
+         * Connections take turns by deficit round-robin, each turn is
+         * worth quantum * weight bytes.
+         * After blocking the connection keeps its turn.
          */
-        _trip_connection_t *c = sendq_dq(&r->sendq);
-        while (c)
+        _trip_connection_t *c = sendq_peek(&r->sendq);
+        while (c && sent < r->max_packet_send_count)
         {
 #if DEBUG_ROUTER
             printf("%s: send from connection\n", __func__);
 #endif
 
-            bool re_q = true;
-            uint32_t connsent = 0;
-            for (; connsent < r->max_connection_send_count; ++connsent, ++sent)
+            if (c->deficit <= 0)
+            {
+                /* Turn is over. */
+                sendq_rotate(&r->sendq);
+                c = sendq_peek(&r->sendq);
+                continue;
+            }
+
+            r->sendlen = _tripc_send(c, r->buflen, r->buf);
+
+            if (NPOS == r->sendlen)
+            {
+                /* We made an error. */
+                r->sendlen = 0;
+                // TODO I don't think this is a shutdown error...
+                _trip_set_error(r, ECOMM, NULL);
+                return;
+            }
+            else if (r->sendlen)
             {
-                r->sendlen = _tripc_send(c, r->buflen, r->buf);
+                sendq_charge(&r->sendq, c, r->sendlen);
 
-                if (NPOS == r->sendlen)
-                {
-                    /* We made an error. */
-                    r->sendlen = 0;
-                    // TODO I don't think this is a shutdown error...
-                    _trip_set_error(r, ECOMM, NULL);
-                    return;
-                }
-                else if (r->sendlen)
-                {
-                    int wcode = p->send(p, c->src, r->sendlen, r->buf);
+                int wcode = p->send(p, c->dst, r->sendlen, r->buf);
 
-                    if (wcode)
+                if (wcode)
+                {
+                    if (EWOULDBLOCK != wcode && EAGAIN != wcode)
                     {
-                        if (EWOULDBLOCK != wcode && EAGAIN != wcode)
-                        {
-                            _trip_set_error(r, wcode, NULL);
-                        }
-                        else
-                        {
-                            /* Packet not sent and we would block. */
-                            r->sendsrc = c->src;
-                        }
-                        return;
+                        _trip_set_error(r, wcode, NULL);
                     }
                     else
                     {
-                        /* Packet was sent. Ready for next connection. */
-                        r->sendlen = 0;
+                        /* Packet not sent and we would block. */
+                        r->sendsrc = c->dst;
                     }
+                    return;
                 }
                 else
                 {
-                    /* Don't re-enqueue. Done sending. */
-                    re_q = false;
-                    break;
+                    /* Packet was sent. */
+                    r->sendlen = 0;
+                    ++sent;
                 }
             }
-
-            if (re_q)
-            {
-                sendq_nq(&r->sendq, c);
-            }
-
-            if (sent > r->max_packet_send_count)
+            else
             {
-                break;
+                /* Don't re-enqueue. Done sending. */
+                sendq_dq(&r->sendq);
+                c = sendq_peek(&r->sendq);
             }
-
-            c = sendq_dq(&r->sendq);
         }
     }
 }
@@ -384,9 +482,182 @@ void
 _trip_close_connection(_trip_router_t *r, _trip_connection_t *c)
 {
     c->router->connection((trip_connection_t *)c);
-    connmap_del(&r->conn, c->self.id);
+    connmap_del(&r->conn, c->id);
+    _tripc_destroy(c);
+    _trip_free_connection(c);
+}
+
+/**
+ * Swap an idle connection out for a compact record.
+ * The hook is told first since the handle is freed.
+ * @return False if the connection must stay awake.
+ */
+bool
+_trip_hibernate(_trip_router_t *r, _trip_connection_t *c)
+{
+    size_t index = 0;
+    connrec_t *rec = connrecs_add(&r->recs, &index);
+
+    if (!rec)
+    {
+        return false;
+    }
+
+    if (r->hibernate)
+    {
+        r->hibernate((trip_connection_t *)c, true);
+    }
+
+    size_t i = 0;
+    size_t len = sizeof(r->connsrc)/sizeof(r->connsrc[0]);
+    for (; i < len; ++i)
+    {
+        if (r->connsrc[i] == c)
+        {
+            r->connsrc[i] = NULL;
+        }
+    }
+
+    _tripc_hibernate(c, rec);
+    connmap_sleep(&r->conn, c->id, index);
     _tripc_destroy(c);
     _trip_free_connection(c);
+
+    return true;
+}
+
+static void
+_trip_keepalive_cancel(_trip_router_t *r)
+{
+    if (r->katimer)
+    {
+        _trip_cancel_timeout(r->katimer);
+        r->katimer = NULL;
+    }
+}
+
+/**
+ * Arm katimer for the earliest occupied keepalive slot, moving it sooner
+ * if a connection was filed ahead of it.
+ */
+static void
+_trip_keepalive_arm(_trip_router_t *r)
+{
+    uint64_t next = keepalive_next(&r->keepalive);
+
+    if (r->katimer)
+    {
+        if (r->kadeadline <= next)
+        {
+            return;
+        }
+
+        _trip_keepalive_cancel(r);
+    }
+
+    if (TRIPTIME_END == next)
+    {
+        return;
+    }
+
+    /* At most a lap ahead. */
+    uint64_t now = triptime_now();
+    int ms = next > now ? (int)(next - now) : 0;
+
+    r->katimer = _trip_set_timeout(r, ms, r, _trip_keepalive_cb);
+    r->kadeadline = next;
+}
+
+/**
+ * Sweep the keepalives due, then wait for the next occupied slot.
+ */
+static void
+_trip_keepalive_cb(void *_r)
+{
+    trip_torouter(r, _r);
+
+    uint64_t now = triptime_now();
+    _trip_connection_t *c = NULL;
+
+    r->katimer = NULL;
+
+    while ((c = keepalive_pop(&r->keepalive, now)))
+    {
+        _tripc_keepalive(c, now);
+    }
+
+    _trip_keepalive_arm(r);
+}
+
+/**
+ * File the connection for a keepalive at when, instead of its own timer.
+ */
+void
+_trip_keepalive(_trip_router_t *r, _trip_connection_t *c, uint64_t when)
+{
+    keepalive_add(&r->keepalive, c, when);
+    _trip_keepalive_arm(r);
+}
+
+/**
+ * Rehydrate a hibernated connection for an incoming packet.
+ * @return NULL if the ID isn't hibernated or out of memory.
+ */
+static _trip_connection_t *
+_trip_wake(_trip_router_t *r, uint64_t id)
+{
+    size_t index = 0;
+
+    if (!connmap_asleep(&r->conn, id, &index))
+    {
+        return NULL;
+    }
+
+    _trip_connection_t *c = _trip_new_connection(r);
+
+    if (!c)
+    {
+        return NULL;
+    }
+
+    connrec_t *rec = connrecs_get(&r->recs, index);
+
+    if (_tripc_wake(c, r, rec))
+    {
+        _trip_free_connection(c);
+        return NULL;
+    }
+
+    connrecs_del(&r->recs, index);
+    connmap_wake(&r->conn, id, c);
+
+    if (r->hibernate)
+    {
+        r->hibernate((trip_connection_t *)c, false);
+    }
+
+    return c;
+}
+
+/**
+ * Wake for a segment only if the record allows it could be the peer's:
+ * handshakes are over before a connection sleeps, and sequences below the
+ * floor were seen before it did.
+ * @return NULL if not hibernated, screened out, or out of memory.
+ */
+static _trip_connection_t *
+_trip_wake_segment(_trip_router_t *r, const _trip_prefix_t *prefix)
+{
+    size_t index = 0;
+
+    if (!connmap_asleep(&r->conn, prefix->id, &index)
+        || _TRIP_CONTROL_CHAL == prefix->control
+        || prefix->seq < connrecs_get(&r->recs, index)->seqfloor)
+    {
+        return NULL;
+    }
+
+    return _trip_wake(r, prefix->id);
 }
 
 void
@@ -397,15 +668,30 @@ _trip_close(_trip_router_t *r, int gracems)
     while (i != end)
     {
         _trip_connection_t *c = connmap_iter_get(&r->conn, i);
-        tripc_close((trip_connection_t *)c, gracems);
-        if (0 == gracems)
+        if (c)
         {
-            _trip_free_connection(c);
+            tripc_close((trip_connection_t *)c, gracems);
+            if (0 == gracems)
+            {
+                /* Out of the keepalive ring and the send queue first. */
+                _tripc_destroy(c);
+                _trip_free_connection(c);
+            }
         }
         ++i;
     }
 
+    if (0 == gracems)
+    {
+        /* Every connection has left the ring. */
+        _trip_keepalive_cancel(r);
+    }
+
+    /* The snapshot keeps the connections as they were for a restore. */
+    _trip_snapshot_cancel(r);
+
     connmap_clear(&r->conn);
+    connrecs_destroy(&r->recs);
 }
 
 static void
@@ -468,7 +754,7 @@ _trip_connection_t *
 _trip_router_get_conn_by_src(_trip_router_t *r, int src, uint64_t peerid)
 {
     _trip_connection_t *c = r->connsrc[src % 2];
-    return c && c->peer.id == peerid ? c : NULL;
+    return c && c->peerid == peerid ? c : NULL;
 }
 
 /**
@@ -484,77 +770,242 @@ _trip_decrypt(_trip_router_t *r, size_t len, unsigned char *buf)
     return EINVAL;
 }
 
-static void
-_trip_segment(_trip_router_t *r, int src, size_t len, unsigned char *buf)
+/**
+ * Rebuild a ready connection under its old ID. Consumes the record.
+ * @return NULL if the ID is taken or out of memory.
+ */
+static _trip_connection_t *
+_trip_restore_rec(_trip_router_t *r, connrec_t *rec)
 {
-#if DEBUG_ROUTER
-    printf("%s: buffer len(%lu)\n", __func__, len);
-#endif
+    _trip_connection_t *c = _trip_new_connection(r);
 
-    /* Discard too short segments immediately. */
-    if (len < 16) // TODO calculate the exact min length of a packet
+    if (!c)
     {
-        // TODO add reporting codes
-        _trip_router_reject(r, src, 0);
+        connrec_clear(rec);
+        return NULL;
+    }
+
+    if (connmap_add_id(&r->conn, c, rec->id))
+    {
+        _trip_free_connection(c);
+        connrec_clear(rec);
+        return NULL;
+    }
+
+    if (_tripc_wake(c, r, rec))
+    {
+        connmap_del(&r->conn, rec->id);
+        _trip_free_connection(c);
+        connrec_clear(rec);
+        return NULL;
+    }
+
+    connrec_clear(rec);
+    _tripc_restored(c);
+
+    return c;
+}
+
+/**
+ * A returning client presents a ticket we sealed.
+ * Nothing is touched until the ticket and tag check out. Each ticket is
+ * redeemed once within its lifetime. Data after RESUME is accepted once
+ * the connection is rebuilt; only keys derived from the ticket secret can
+ * produce it.
+ */
+static void
+_trip_resume(_trip_router_t *r, int src, _trip_prefix_t *prefix, size_t len, const unsigned char *buf)
+{
+    if (!r->ticketms || !(r->flag & _TRIPR_FLAG_ALLOW_IN))
+    {
+        _trip_router_reject(r, src, 2);
         return;
     }
 
-    /* Check if the source is flagged for misbehavior. */
-    if (_trip_router_is_reported(r, src))
+    unsigned char salt[_TRIP_NONCE];
+    unsigned char mac[_TICKET_TAG];
+    uint32_t tlen = 0;
+    unsigned char *ticket = NULL;
+    size_t plen = trip_unpack(len, buf, "nkb", salt, mac, &tlen, &ticket);
+
+    if (0 == plen || NPOS == plen)
     {
-        // TODO should this be a feature???
+        _trip_router_reject(r, src, 4);
         return;
     }
 
-    /* Unpack the prefix information. */
-    _trip_prefix_t prefix;
-    size_t end = trip_unpack(len, buf, "CQW",
-                             &prefix.control,
-                             &prefix.id,
-                             &prefix.seq);
+    uint64_t now = triptime_now();
+    uint64_t tag = 0;
+    uint64_t issued = 0;
+    connrec_t rec;
 
-    /* Discard if unpack failed. */
-    if (NPOS == end || 0 == end)
+    if (ticket_open(r->ticketkey, now, (uint64_t)r->ticketms, tlen, ticket, &rec, &tag, &issued))
     {
-        _trip_router_reject(r, src, 1);
+        _trip_router_reject(r, src, 5);
         return;
     }
-#if DEBUG_ROUTER
-    printf("%s: PASSED PREFIX len(%lu) id(%lx)\n", __func__, end, prefix.id);
-#endif
 
-    /* Extract encrypted flag. */
-    prefix.encrypted = prefix.control & _TRIP_PREFIX_EMASK;
-    prefix.control = prefix.control & (~_TRIP_PREFIX_EMASK);
+    ticketkeys_t keys;
+    ticket_derive(rec.ticketsecret, salt, &keys);
 
-    /* Check for valid control. */
-    if (prefix.control >= _TRIP_CONTROL_MAX)
+    if (rec.id != prefix->id || sodium_memcmp(keys.tag, mac, _TICKET_TAG))
     {
-        _trip_router_reject(r, src, 12);
+        sodium_memzero(&keys, sizeof(keys));
+        connrec_clear(&rec);
+        _trip_router_reject(r, src, 5);
         return;
     }
 
-    /* Special treatment for OPEN requests. */
-    if (_TRIP_CONTROL_OPEN == prefix.control)
+    _trip_connection_t *live = connmap_get(&r->conn, prefix->id);
+
+    if (live)
     {
-        /* Check if incoming requests are allowed. */
-        if (!(r->flag & _TRIPR_FLAG_ALLOW_IN))
+        /* Resent RESUME, the connection is back already but our answer
+         * was lost; a new ticket answers it where it came from. A new
+         * source only becomes the route once a PING checks it.
+         */
+        sodium_memzero(&keys, sizeof(keys));
+        connrec_clear(&rec);
+        live->cold->sendticket = true;
+        live->cold->ticketdst = src;
+        if (live->src < 0)
         {
-            _trip_router_reject(r, src, 2);
-            return;
+            live->src = src;
         }
-#if DEBUG_ROUTER
-        printf("%s: PASSED ALLOW IN\n", __func__);
-#endif
-
-        /* Check if encryption is required. */
-        if (!prefix.encrypted && !(r->flag & _TRIPR_FLAG_ALLOW_PLAIN_OPEN))
+        else if (src != live->src)
         {
-            _trip_router_reject(r, src, 3);
-            return;
+            _tripc_path_recv(live, src);
         }
-#if DEBUG_ROUTER
-        printf("%s: PASSED ALLOW PLAIN OPEN\n", __func__);
+        _tripc_set_send(live);
+        return;
+    }
+
+    if (ticketreplay_add(&r->replay, tag, issued, (uint64_t)r->ticketms))
+    {
+        sodium_memzero(&keys, sizeof(keys));
+        connrec_clear(&rec);
+        _trip_router_reject(r, src, 5);
+        return;
+    }
+
+    /* A hibernated record is newer than the ticket, and the user knows
+     * of it already.
+     */
+    _trip_connection_t *c = _trip_wake(r, prefix->id);
+    bool restored = !c;
+
+    if (c)
+    {
+        connrec_clear(&rec);
+    }
+    else
+    {
+        c = _trip_restore_rec(r, &rec);
+    }
+
+    if (!c)
+    {
+        sodium_memzero(&keys, sizeof(keys));
+        _trip_router_reject(r, src, 50);
+        return;
+    }
+
+    _tripc_resume_keys(c, &keys);
+    sodium_memzero(&keys, sizeof(keys));
+    c->src = src;
+
+    /* Answering stops the client resending RESUME. */
+    _tripc_set_send(c);
+
+    if (restored && r->connection)
+    {
+        r->connection((trip_connection_t *)c);
+    }
+}
+
+/**
+ * @brief Screen the segment and unpack its prefix.
+ * @return Offset past the prefix; zero if the segment was dropped.
+ */
+static size_t
+_trip_segment_prefix(_trip_router_t *r, int src, size_t len, unsigned char *buf,
+                     _trip_prefix_t *prefix)
+{
+    /* Discard too short segments immediately. */
+    if (len < 16) // TODO calculate the exact min length of a packet
+    {
+        // TODO add reporting codes
+        _trip_router_reject(r, src, 0);
+        return 0;
+    }
+
+    /* Check if the source is flagged for misbehavior. */
+    if (_trip_router_is_reported(r, src))
+    {
+        // TODO should this be a feature???
+        return 0;
+    }
+
+    /* Unpack the prefix information. */
+    size_t end = trip_unpack(len, buf, "CQW",
+                             &prefix->control,
+                             &prefix->id,
+                             &prefix->seq);
+
+    /* Discard if unpack failed. */
+    if (NPOS == end || 0 == end)
+    {
+        _trip_router_reject(r, src, 1);
+        return 0;
+    }
+#if DEBUG_ROUTER
+    printf("%s: PASSED PREFIX len(%lu) id(%lx)\n", __func__, end, prefix->id);
+#endif
+
+    /* Extract encrypted flag. */
+    prefix->encrypted = prefix->control & _TRIP_PREFIX_EMASK;
+    prefix->control = prefix->control & (~_TRIP_PREFIX_EMASK);
+
+    /* Check for valid control. */
+    if (prefix->control >= _TRIP_CONTROL_MAX)
+    {
+        _trip_router_reject(r, src, 12);
+        return 0;
+    }
+
+    return end;
+}
+
+/**
+ * @brief Handle a segment past its prefix.
+ * @param c - The connection for the prefix ID if already looked up, or NULL.
+ */
+static void
+_trip_segment_dispatch(_trip_router_t *r, int src, _trip_prefix_t *prefix,
+                       size_t end, size_t len, unsigned char *buf,
+                       _trip_connection_t *c)
+{
+    /* Special treatment for OPEN requests. */
+    if (_TRIP_CONTROL_OPEN == prefix->control)
+    {
+        /* Check if incoming requests are allowed. */
+        if (!(r->flag & _TRIPR_FLAG_ALLOW_IN))
+        {
+            _trip_router_reject(r, src, 2);
+            return;
+        }
+#if DEBUG_ROUTER
+        printf("%s: PASSED ALLOW IN\n", __func__);
+#endif
+
+        /* Check if encryption is required. */
+        if (!prefix->encrypted && !(r->flag & _TRIPR_FLAG_ALLOW_PLAIN_OPEN))
+        {
+            _trip_router_reject(r, src, 3);
+            return;
+        }
+#if DEBUG_ROUTER
+        printf("%s: PASSED ALLOW PLAIN OPEN\n", __func__);
 #endif
 
         /* Unpack version and routing information. */
@@ -589,7 +1040,7 @@ _trip_segment(_trip_router_t *r, int src, size_t len, unsigned char *buf)
         /* Find the connection if it exists.
          * Create if it doesn't exist.
          */
-        _trip_connection_t *c = _trip_router_get_conn_by_src(r, src, prefix.id);
+        c = _trip_router_get_conn_by_src(r, src, prefix->id);
 
         if (!c)
         {
@@ -646,9 +1097,9 @@ _trip_segment(_trip_router_t *r, int src, size_t len, unsigned char *buf)
         }
         else
         {
-            if (c->peer.signpk || !(r->flag & _TRIPR_FLAG_ALLOW_PLAIN_ISIG))
+            if (c->cold->peer.signpk || !(r->flag & _TRIPR_FLAG_ALLOW_PLAIN_ISIG))
             {
-                if (trip_unsign(len, buf, c->peer.signpk))
+                if (trip_unsign(len, buf, c->cold->peer.signpk))
                 {
                     _trip_router_reject(r, src, 203);
                     return;
@@ -672,7 +1123,7 @@ _trip_segment(_trip_router_t *r, int src, size_t len, unsigned char *buf)
         len -= crypto_sign_BYTES;
 
         /* Decrypt OPEN buffer. */
-        unsigned char *opensk = c->self.opensk ? c->self.opensk : r->opensk;
+        unsigned char *opensk = c->cold->self.opensk ? c->cold->self.opensk : r->opensk;
         size_t maclen = trip_unpack(len - end - _TRIP_SIGN, buf + end, "oO", opensk);
 
 
@@ -693,7 +1144,7 @@ _trip_segment(_trip_router_t *r, int src, size_t len, unsigned char *buf)
         // TODO verify that settings don't violate
         // router settings
 
-        if (_tripc_read(c, &prefix, len - end, buf + end))
+        if (_tripc_read(c, prefix, len - end, buf + end))
         {
             /* Invalid OPEN packet. */
             _trip_router_reject(r, src, 22);
@@ -706,40 +1157,75 @@ _trip_segment(_trip_router_t *r, int src, size_t len, unsigned char *buf)
 
         _tripc_set_send(c);
     }
+    else if (_TRIP_CONTROL_RESUME == prefix->control)
+    {
+        _trip_resume(r, src, prefix, len - end, buf + end);
+    }
     else
     {
-        if (!prefix.encrypted && !(r->flag & _TRIPR_FLAG_ALLOW_PLAIN_COMM))
+        if (!prefix->encrypted && !(r->flag & _TRIPR_FLAG_ALLOW_PLAIN_COMM))
         {
             /* Not encrypted when required. */
             _trip_router_reject(r, src, 7);
             return;
         }
 
-        _trip_connection_t *c = connmap_get(&r->conn, prefix.id);
+        bool woken = false;
+
+        if (!c)
+        {
+            c = connmap_get(&r->conn, prefix->id);
+        }
+        if (!c)
+        {
+            c = _trip_wake_segment(r, prefix);
+            woken = NULL != c;
+        }
         if (c)
         {
-            // TODO unsign CHALLENGE PACKETS
-            if (_TRIP_CONTROL_CHAL == prefix.control
-                && (c->peer.signpk
-                    || !(r->flag & _TRIPR_FLAG_ALLOW_PLAIN_OSIG)))
+            /* Only CHAL is signed once OPEN is past. */
+            if (_TRIP_CONTROL_CHAL == prefix->control)
             {
-                if (trip_unsign(len, buf, c->peer.signpk))
+                if (c->cold->peer.signpk
+                    || !(r->flag & _TRIPR_FLAG_ALLOW_PLAIN_OSIG))
                 {
-                    _trip_router_reject(r, src, 203);
-                    return;
+                    if (trip_unsign(len, buf, c->cold->peer.signpk))
+                    {
+                        _trip_router_reject(r, src, 203);
+                        return;
+                    }
                 }
+                else
+                {
+                    // TODO verify that signature is zeros
+                }
+                len -= crypto_sign_BYTES;
             }
-            else
-            {
-                // TODO verify that signature is zeros
-            }
-            len -= crypto_sign_BYTES;
 
-            if (_tripc_read(c, &prefix, len - end, buf + end))
+            if (_tripc_read(c, prefix, len - end, buf + end))
             {
+                if (woken && _tripc_is_idle(c, 0))
+                {
+                    /* Nothing came of it; back to sleep so guessed IDs
+                     * can't keep hibernated connections in memory.
+                     */
+                    _trip_hibernate(r, c);
+                }
                 _trip_router_reject(r, src, 79);
                 return;
             }
+
+            if (c->src < 0)
+            {
+                /* Restored; the first authenticated packet says where. */
+                c->src = src;
+                _tripc_set_send(c);
+            }
+            else if (src != c->src)
+            {
+                /* Pings are when the send address is checked. */
+                _tripc_path_recv(c, src);
+            }
         }
         else
         {
@@ -749,6 +1235,22 @@ _trip_segment(_trip_router_t *r, int src, size_t len, unsigned char *buf)
     }
 }
 
+static void
+_trip_segment(_trip_router_t *r, int src, size_t len, unsigned char *buf)
+{
+#if DEBUG_ROUTER
+    printf("%s: buffer len(%lu)\n", __func__, len);
+#endif
+
+    _trip_prefix_t prefix;
+    size_t end = _trip_segment_prefix(r, src, len, buf, &prefix);
+
+    if (end)
+    {
+        _trip_segment_dispatch(r, src, &prefix, end, len, buf, NULL);
+    }
+}
+
 /**
  * @warn This should be the last function called to prevent side-effects.
  */
@@ -883,8 +1385,86 @@ trip_seg(trip_router_t *_r, int src, size_t len, void *buf)
 
     if (_TRIPR_STATE_LISTEN == r->state || _TRIPR_STATE_CLOSE == r->state)
     {
+        _trip_enter(r);
         _trip_segment(r, src, len, (unsigned char *)buf);
+        _trip_leave(r);
+    }
+}
+
+/**
+ * Hand the router segments read together, as trip_seg for each in order.
+ * Each stage runs over the whole batch so its loads overlap rather than
+ * each segment waiting on its own misses: prefixes are unpacked and map
+ * entries prefetched, then connections are found and their hot part
+ * prefetched, then segments are handled.
+ */
+void
+trip_seg_batch(trip_router_t *_r, int n, const int *srcs, const size_t *lens,
+               void *const *bufs)
+{
+    trip_torouter(r, _r);
+
+    if (_TRIPR_STATE_LISTEN != r->state && _TRIPR_STATE_CLOSE != r->state)
+    {
+        return;
+    }
+
+    _trip_prefix_t prefix[_TRIPR_SEG_BATCH];
+    size_t end[_TRIPR_SEG_BATCH];
+    _trip_connection_t *conn[_TRIPR_SEG_BATCH];
+    bool lookup[_TRIPR_SEG_BATCH];
+
+    _trip_enter(r);
+
+    int base;
+    for (base = 0; base < n && !r->error; base += _TRIPR_SEG_BATCH)
+    {
+        int count = n - base < _TRIPR_SEG_BATCH ? n - base : _TRIPR_SEG_BATCH;
+        int i;
+
+        /* OPEN and RESUME find their connections their own way. */
+        for (i = 0; i < count; ++i)
+        {
+            end[i] = _trip_segment_prefix(r, srcs[base + i], lens[base + i],
+                                          bufs[base + i], &prefix[i]);
+            lookup[i] = end[i]
+                && _TRIP_CONTROL_OPEN != prefix[i].control
+                && _TRIP_CONTROL_RESUME != prefix[i].control;
+            if (lookup[i])
+            {
+                connmap_prefetch(&r->conn, prefix[i].id);
+            }
+        }
+
+        for (i = 0; i < count; ++i)
+        {
+            conn[i] = NULL;
+            if (lookup[i])
+            {
+                conn[i] = connmap_get(&r->conn, prefix[i].id);
+                if (conn[i])
+                {
+                    _tripc_prefetch(conn[i]);
+                }
+            }
+        }
+
+        /* Handling a segment may close or hibernate a connection found
+         * for a later one; then look it up again.
+         */
+        uint64_t gen = r->conn.gen;
+        for (i = 0; i < count; ++i)
+        {
+            if (end[i])
+            {
+                _trip_segment_dispatch(r, srcs[base + i], &prefix[i], end[i],
+                                       lens[base + i], bufs[base + i],
+                                       gen == r->conn.gen ? conn[i] : NULL);
+            }
+        }
     }
+
+    _trip_leave(r);
 }
 
 void
@@ -999,12 +1579,27 @@ trip_watch(trip_router_t *_r, trip_socket_t fd, int events)
             r->flag |= _TRIPR_FLAG_ALWAYS_READY;
             if (sendq_has(&r->sendq))
             {
-                _trip_set_timeout(r, 0, r, _trip_send_immediately_cb);
+                _trip_flush_later(r, 0);
             }
         }
     }
     else
     {
+        /* The descriptor read from is the one sent on. */
+        if (TRIP_REMOVE == events)
+        {
+            if (fd == r->txfd)
+            {
+                r->txfd = TRIP_SOCKET_TIMEOUT;
+                r->txevents = 0;
+            }
+        }
+        else if (events & TRIP_IN)
+        {
+            r->txfd = fd;
+            r->txevents = events;
+        }
+
         void *data = sockmap_get(&r->sockmap, fd);
         r->watch(_r, fd, events, data);
     }
@@ -1102,16 +1697,29 @@ trip_new(enum trip_preset preset)
         r->max_out = r->max_conn;
         r->max_packet_read_count = 1024;
         r->max_packet_send_count = 1024;
-        r->max_connection_send_count = 128;
         r->max_streams = _TRIPR_DEFAULT_MAX_STREAM;
+        r->stream_lowat = _TRIPR_DEFAULT_STREAM_LOWAT;
+        r->stream_hiwat = _TRIPR_DEFAULT_STREAM_HIWAT;
+        r->renewms = _RENEW_OVERLAP_MS;
+        r->keepalivems = _TRIPR_DEFAULT_KEEPALIVE;
+        keepalive_init(&r->keepalive, triptime_now());
         r->flag = _TRIPR_FLAG_ALLOW_IN | _TRIPR_FLAG_ALLOW_OUT;
 
-        r->buflen = 1200;
+        r->basepmtu = _PMTU_BASE;
+        r->maxpmtu = _PMTU_BASE;
+        r->buflen = r->maxpmtu;
         r->buf = tripm_alloc(r->buflen);
         r->sendlen = 0;
         r->sendsrc = 0;
+        rxpool_init(&r->rxpool, r->buflen, _TRIPR_DEFAULT_RXPOOL);
+        sendq_init(&r->sendq, (uint32_t)r->buflen);
 
         r->mindeadline = TRIPTIME_END;
+        r->txfd = TRIP_SOCKET_TIMEOUT;
+
+        mpscq_init(&r->submitq);
+        r->subfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        r->owned = false;
 
         /* Modify values according to preset. */
         switch (preset)
@@ -1138,6 +1746,9 @@ trip_new(enum trip_preset preset)
 
         resolveq_init(&r->resolveq);
         connmap_init(&r->conn, r->max_conn);
+        connrecs_init(&r->recs);
+        ticketreplay_init(&r->replay);
+        randombytes_buf(r->ticketkey, sizeof(r->ticketkey));
         timerwheel_init(&r->wheel);
         r->connsrc[0] = NULL;
         r->connsrc[1] = NULL;
@@ -1160,13 +1771,30 @@ trip_free(trip_router_t *_r)
         r->packet = NULL;
     }
 
-    tripm_cfree(r->poll);
+    if (-1 != r->subfd)
+    {
+        mpscq_node_t *node;
+        while (NULL != (node = mpscq_pop(&r->submitq)))
+        {
+            _trip_submit_run(r, (_trip_submit_t *)node, true);
+        }
+        close(r->subfd);
+    }
+
+    _trip_poll_free(r->poll);
     tripm_cfree(r->errmsg);
     tripm_cfree(r->buf);
 
+    _trip_keepalive_cancel(r);
+    _trip_snapshot_cancel(r);
     timerwheel_destroy(&r->wheel);
+    rxpool_destroy(&r->rxpool);
     connmap_destroy(&r->conn);
+    connrecs_destroy(&r->recs);
+    ticketreplay_destroy(&r->replay);
+    tripm_cfree(r->snappath);
     resolveq_destroy(&r->resolveq);
+    sodium_memzero(r->ticketkey, sizeof(r->ticketkey));
 
     tripm_free(r);
 }
@@ -1221,6 +1849,157 @@ trip_setopt(trip_router_t *_r, enum trip_router_opt opt, ...)
         case TRIPOPT_MESSAGE_CB:
             r->message = va_arg(ap, trip_handle_message_t *);
             break;
+        case TRIPOPT_WRITABLE_CB:
+            r->writable = va_arg(ap, trip_handle_stream_t *);
+            break;
+        case TRIPOPT_HIBERNATE:
+            {
+                int ms = va_arg(ap, int);
+                trip_handle_hibernate_t *cb = va_arg(ap, trip_handle_hibernate_t *);
+                if (ms < 0)
+                {
+                    rval = EINVAL;
+                    break;
+                }
+                r->hibernatems = ms;
+                r->hibernate = cb;
+            }
+            break;
+        case TRIPOPT_TICKET:
+            {
+                int ms = va_arg(ap, int);
+                unsigned char *key = va_arg(ap, unsigned char *);
+                if (ms < 0)
+                {
+                    rval = EINVAL;
+                    break;
+                }
+                /* TICK carries the resume secret between 'e' and 'E', which
+                 * trip_pack does not encrypt yet; issuing one would hand the
+                 * resume keys to anyone on the path.
+                 * TODO allow once segments are sealed.
+                 */
+                if (ms)
+                {
+                    rval = ENOTSUP;
+                    break;
+                }
+                r->ticketms = ms;
+                if (key)
+                {
+                    /* Shared so tickets survive restarts and peers. */
+                    memcpy(r->ticketkey, key, sizeof(r->ticketkey));
+                }
+                else
+                {
+                    randombytes_buf(r->ticketkey, sizeof(r->ticketkey));
+                }
+            }
+            break;
+        case TRIPOPT_RENEW:
+            {
+                uint64_t bytes = va_arg(ap, uint64_t);
+                uint64_t packets = va_arg(ap, uint64_t);
+                int ms = va_arg(ap, int);
+                if (ms < 0)
+                {
+                    rval = EINVAL;
+                    break;
+                }
+                r->renewbytes = bytes;
+                r->renewpackets = packets;
+                r->renewms = ms ? ms : _RENEW_OVERLAP_MS;
+            }
+            break;
+        case TRIPOPT_KEEPALIVE:
+            {
+                int ms = va_arg(ap, int);
+                if (ms < _KEEPALIVE_TICK_MS)
+                {
+                    rval = EINVAL;
+                    break;
+                }
+                r->keepalivems = ms;
+            }
+            break;
+        case TRIPOPT_RUN_EDGE:
+            {
+                /* Descriptors are watched at bind; change before then. */
+                int edge = va_arg(ap, int);
+                if (_TRIPR_STATE_START != r->state)
+                {
+                    rval = EINVAL;
+                    break;
+                }
+                if (edge)
+                {
+                    r->flag |= _TRIPR_FLAG_RUN_EDGE;
+                }
+                else
+                {
+                    r->flag &= ~_TRIPR_FLAG_RUN_EDGE;
+                }
+            }
+            break;
+        case TRIPOPT_RUN_BUSY_POLL:
+            {
+                int us = va_arg(ap, int);
+                int sockopt = va_arg(ap, int);
+                if (_TRIPR_STATE_START != r->state || us < 0)
+                {
+                    rval = EINVAL;
+                    break;
+                }
+                r->busypollus = us;
+                if (us && sockopt)
+                {
+                    r->flag |= _TRIPR_FLAG_BUSY_SOCKOPT;
+                }
+                else
+                {
+                    r->flag &= ~_TRIPR_FLAG_BUSY_SOCKOPT;
+                }
+            }
+            break;
+        case TRIPOPT_PMTU:
+            {
+                size_t base = va_arg(ap, size_t);
+                size_t max = va_arg(ap, size_t);
+                if (_TRIPR_STATE_START != r->state
+                    || base < _PMTU_BASE || max < base || max > _PMTU_MAX)
+                {
+                    rval = EINVAL;
+                    break;
+                }
+                unsigned char *buf = tripm_realloc(r->buf, max);
+                if (!buf)
+                {
+                    rval = ENOMEM;
+                    break;
+                }
+                r->buf = buf;
+                r->buflen = max;
+                r->basepmtu = base;
+                r->maxpmtu = max;
+                /* Receive buffers must hold the largest probe. */
+                rxpool_destroy(&r->rxpool);
+                rxpool_init(&r->rxpool, r->buflen, _TRIPR_DEFAULT_RXPOOL);
+                sendq_init(&r->sendq, (uint32_t)r->buflen);
+            }
+            break;
+        case TRIPOPT_STREAM_WATERMARK:
+            {
+                size_t lowat = va_arg(ap, size_t);
+                size_t hiwat = va_arg(ap, size_t);
+                if (!hiwat || lowat >= hiwat)
+                {
+                    rval = EINVAL;
+                    break;
+                }
+                r->stream_lowat = lowat;
+                r->stream_hiwat = hiwat;
+            }
+            break;
         case TRIPOPT_ALLOW_PLAIN_OPEN:
             {
                 val = va_arg(ap, int *);
@@ -1273,6 +2052,19 @@ trip_setopt(trip_router_t *_r, enum trip_router_opt opt, ...)
                 }
             }
             break;
+        case TRIPOPT_RECV_LOAN:
+            {
+                val = va_arg(ap, int *);
+                if (val && (*val))
+                {
+                    r->flag |= _TRIPR_FLAG_RECV_LOAN;
+                }
+                else
+                {
+                    r->flag &= ~_TRIPR_FLAG_RECV_LOAN;
+                }
+            }
+            break;
         default:
             rval = EINVAL;
             break;
@@ -1291,13 +2083,147 @@ trip_errmsg(trip_router_t *_r)
 }
 
 /**
- * Indicate that a timeout has been reached.
+ * @brief Give back a buffer loaned by a TRIPM_RECV message.
+ *
+ * Takes the router rather than the stream, the stream may be gone by the
+ * time the user is done with the buffer. Router thread only.
+ * @note Nothing parses DATA segments yet (_tripc_parse_data), so until it
+ * does no message is delivered and TRIPOPT_RECV_LOAN loans nothing.
+ * @param buf - The exact pointer passed to the message callback.
  */
-int
-trip_timeout(trip_router_t *_r)
+void
+trip_release(trip_router_t *_r, unsigned char *buf)
 {
     trip_torouter(r, _r);
 
+    if (buf)
+    {
+        rxpool_unref(&r->rxpool, buf);
+    }
+}
+
+/* CROSS-THREAD SUBMISSION */
+
+/**
+ * @brief The thread that started the router owns it; before that any
+ * thread may configure it.
+ */
+bool
+_trip_is_owner(_trip_router_t *r)
+{
+    return !r->owned || pthread_equal(r->owner, pthread_self());
+}
+
+static void
+_trip_submit_wake(_trip_router_t *r)
+{
+    uint64_t one = 1;
+    if (-1 == write(r->subfd, &one, sizeof(one)))
+    {
+        /* EAGAIN only when the counter is saturated, a wake up is pending. */
+    }
+}
+
+/**
+ * @brief Any thread. Queue a call for the router thread and wake it.
+ * @return Zero on success; errno otherwise, the submission is not taken.
+ */
+int
+_trip_submit(_trip_router_t *r, _trip_submit_t *sub)
+{
+    if (-1 == r->subfd)
+    {
+        return ENOTSUP;
+    }
+
+    if (mpscq_push(&r->submitq, &sub->node))
+    {
+        _trip_submit_wake(r);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Replay or abandon one submission, then free it.
+ */
+static void
+_trip_submit_run(_trip_router_t *r, _trip_submit_t *sub, bool abandon)
+{
+    _trip_stream_t *s = NULL;
+
+    if (_TRIP_SUBMIT_OPEN == sub->kind)
+    {
+        if (abandon)
+        {
+            _trip_reject_connection(r, sub->data, sub->ilen, sub->info, ECANCELED);
+        }
+        else
+        {
+            trip_open_connection((trip_router_t *)r, sub->data, sub->ilen, sub->info);
+        }
+        tripm_free(sub);
+        return;
+    }
+
+    if (!abandon)
+    {
+        s = _trips_resolve(r, &sub->ref);
+    }
+
+    int code = ENOTCONN;
+
+    if (s && _TRIP_SUBMIT_SEND == sub->kind)
+    {
+        code = trips_send((trip_stream_t *)s, sub->len, sub->buf);
+    }
+    else if (s)
+    {
+        code = trips_sendv((trip_stream_t *)s, sub->iov, sub->iovcnt,
+                           sub->release, sub->ctx);
+    }
+
+    if (code && _TRIP_SUBMIT_SENDV == sub->kind && sub->release)
+    {
+        sub->release((trip_stream_t *)s, TRIPM_KILL, sub->ctx);
+    }
+
+    tripm_free(sub);
+}
+
+/**
+ * @brief Replay a batch of submissions; wake again if more remain.
+ */
+static void
+_trip_submit_drain(_trip_router_t *r)
+{
+    uint64_t count;
+    if (-1 == read(r->subfd, &count, sizeof(count)))
+    {
+        /* EAGAIN, a previous drain already took the signal. */
+    }
+
+    int n;
+    for (n = 0; n < _TRIPR_SUBMIT_BATCH; ++n)
+    {
+        mpscq_node_t *node = mpscq_pop(&r->submitq);
+        if (!node)
+        {
+            break;
+        }
+
+        _trip_submit_run(r, (_trip_submit_t *)node, false);
+    }
+
+    if (!mpscq_empty(&r->submitq))
+    {
+        _trip_submit_wake(r);
+    }
+}
+
+static void
+_trip_timeout(_trip_router_t *r)
+{
     /* First handle timeouts. */
     uint64_t now = triptime_now();
     timer_entry_t *e = timerwheel_walk_with(&r->wheel, now);
@@ -1322,19 +2248,25 @@ trip_timeout(trip_router_t *_r)
     }
 
     r->timeout((trip_router_t *)r, (long)ms);
-
-    return r->error;
 }
 
 /**
- * Perform any needed actions on timeout or socket event.
- * Called by trip_start to get the ball rolling.
- * Only a limited number of actions will take place to help prevent starvation
- * of other resources.
- * @return Errno; get string message with trip_errmsg.
+ * Indicate that a timeout has been reached.
  */
 int
-trip_action(trip_router_t *_r, trip_socket_t fd, int events)
+trip_timeout(trip_router_t *_r)
+{
+    trip_torouter(r, _r);
+
+    _trip_enter(r);
+    _trip_timeout(r);
+    _trip_leave(r);
+
+    return r->error;
+}
+
+static int
+_trip_action(trip_router_t *_r, trip_socket_t fd, int events)
 {
 #if DEBUG_ROUTER
     printf("%s\n", __func__);
@@ -1342,6 +2274,12 @@ trip_action(trip_router_t *_r, trip_socket_t fd, int events)
 
     _trip_router_t *r = (_trip_router_t *)_r;
 
+    if (-1 != r->subfd && fd == r->subfd)
+    {
+        _trip_submit_drain(r);
+        return r->error;
+    }
+
     if (TRIP_SOCKET_TIMEOUT == fd)
     {
         // TODO this is clunky... find better way
@@ -1491,6 +2429,26 @@ trip_action(trip_router_t *_r, trip_socket_t fd, int events)
     return r->error;
 }
 
+/**
+ * Perform any needed actions on timeout or socket event.
+ * Called by trip_start to get the ball rolling.
+ * Only a limited number of actions will take place to help prevent starvation
+ * of other resources.
+ * Sends queued along the way are flushed before returning.
+ * @return Errno; get string message with trip_errmsg.
+ */
+int
+trip_action(trip_router_t *_r, trip_socket_t fd, int events)
+{
+    trip_torouter(r, _r);
+
+    _trip_enter(r);
+    _trip_action(_r, fd, events);
+    _trip_leave(r);
+
+    return r->error;
+}
+
 /**
  * Associate data with the socket descriptor.
  */
@@ -1521,9 +2479,18 @@ trip_start(trip_router_t *_r)
 
     if (_TRIPR_STATE_START == r->state)
     {
+        r->owner = pthread_self();
+        r->owned = true;
+
         // TODO make asynchronous
         // TODO use state transition, not action...
-        return trip_action(_r, TRIP_SOCKET_TIMEOUT, 0);
+        int c = trip_action(_r, TRIP_SOCKET_TIMEOUT, 0);
+        if (!c && -1 != r->subfd)
+        {
+            r->watch(_r, r->subfd, TRIP_IN, NULL);
+        }
+
+        return c;
     }
     else
     {
@@ -1586,10 +2553,12 @@ _trip_reject_connection(_trip_router_t *r, void *data, size_t ilen,
                         unsigned char *info, int err)
 {
     _trip_connection_t c;
+    _trip_connection_cold_t cold;
+    c.cold = &cold;
     _tripc_init(&c, r, false);
-    c.data = data;
-    c.ilen = ilen;
-    c.info = info;
+    c.cold->data = data;
+    c.cold->ilen = ilen;
+    c.cold->info = info;
     _tripc_set_error(&c, err, NULL);
     r->connection((trip_connection_t *)&c);
     _tripc_destroy(&c);
@@ -1608,7 +2577,7 @@ _trip_open_connection_async_cb(void *_c)
 
     _trip_router_t *r = c->router;
     _tripc_start(c);
-    r->packet->resolve(r->packet, c->resolvekey, c->ilen, c->info);
+    r->packet->resolve(r->packet, c->cold->resolvekey, c->cold->ilen, c->cold->info);
 }
 
 /**
@@ -1619,6 +2588,8 @@ _trip_open_connection_async_cb(void *_c)
  * @param ilen - The length of the information (see packet documentation).
  * @param info - The information to specify where to connect to
  *               (see packet documentation).
+ * From another thread the open is queued and reported by the router thread
+ * as usual; if it cannot be queued nothing is reported.
  * TODO there is a race condition where the router may not be bound when opening!!!
  */
 void
@@ -1631,6 +2602,26 @@ trip_open_connection(trip_router_t *_r, void *data, size_t ilen,
     printf("%s\n", __func__);
 #endif
 
+    if (!_trip_is_owner(r))
+    {
+        _trip_submit_t *sub = tripm_alloc(sizeof(_trip_submit_t));
+        if (sub)
+        {
+            memset(sub, 0, sizeof(_trip_submit_t));
+            sub->kind = _TRIP_SUBMIT_OPEN;
+            sub->data = data;
+            sub->ilen = ilen;
+            sub->info = info;
+            if (!_trip_submit(r, sub))
+            {
+                return;
+            }
+            tripm_free(sub);
+        }
+        /* Cannot be reported from this thread. */
+        return;
+    }
+
     if (r->flag & _TRIPR_FLAG_ALLOW_OUT)
     {
         _trip_connection_t *c = _trip_new_connection(r);
@@ -1642,11 +2633,11 @@ trip_open_connection(trip_router_t *_r, void *data, size_t ilen,
         }
 
         _tripc_init(c, r, false);
-        c->data = data;
-        c->ilen = ilen;
-        c->info = info;
+        c->cold->data = data;
+        c->cold->ilen = ilen;
+        c->cold->info = info;
         // TODO make sure that after being resolved we delete the entry
-        c->resolvekey = resolveq_put(&r->resolveq, c);
+        c->cold->resolvekey = resolveq_put(&r->resolveq, c);
 
         /* Acquire connection ID on this router. */
         if (connmap_add(&r->conn, c))
@@ -1681,3 +2672,496 @@ trip_open_connection(trip_router_t *_r, void *data, size_t ilen,
     }
 }
 
+/**
+ * Resume a connection from tripc_serialize without a handshake.
+ * Screen keys are not part of the blob; router keys apply.
+ * @return NULL if the blob is invalid, the ID is taken, or out of memory.
+ */
+trip_connection_t *
+trip_restore_connection(trip_router_t *_r, void *data, size_t len, const unsigned char *buf)
+{
+    trip_torouter(r, _r);
+
+    connrec_t rec;
+
+    if (NPOS == connrec_unpack(&rec, len, buf))
+    {
+        return NULL;
+    }
+
+    rec.data = data;
+    rec.sequence += _TRIPR_RESTORE_SEQ_SKIP;
+
+    return (trip_connection_t *)_trip_restore_rec(r, &rec);
+}
+
+/**
+ * Restore the client side from tripc_serialize and present its ticket.
+ * Both sides move to keys derived from the ticket secret, so sequences
+ * carry on as they were.
+ * Sends may start right away; they follow RESUME in the same flight.
+ * @return NULL if the blob has no ticket or can't be restored.
+ */
+trip_connection_t *
+trip_resume_connection(trip_router_t *_r, void *data, size_t len, const unsigned char *buf)
+{
+    trip_torouter(r, _r);
+
+    connrec_t rec;
+
+    if (NPOS == connrec_unpack(&rec, len, buf))
+    {
+        return NULL;
+    }
+
+    if (!rec.ticketlen || (rec.flags & _CONNREC_INCOMING)
+        || are_zeros(sizeof(rec.ticketsecret), rec.ticketsecret))
+    {
+        connrec_clear(&rec);
+        return NULL;
+    }
+
+    rec.data = data;
+
+    _trip_connection_t *c = _trip_restore_rec(r, &rec);
+
+    if (c)
+    {
+        /* Keys the ticket's keys sealed under are never used again. */
+        _tripc_resume(c);
+    }
+
+    return (trip_connection_t *)c;
+}
+
+/**
+ * Size of a connmap entry's blob, live or hibernated.
+ * @return NPOS if it can't be serialized.
+ */
+static size_t
+_trip_snapshot_len(_trip_router_t *r, size_t it)
+{
+    _trip_connection_t *c = connmap_iter_get(&r->conn, it);
+
+    if (c)
+    {
+        return tripc_serialize((trip_connection_t *)c, 0, NULL);
+    }
+
+    size_t index = connmap_iter_rec(&r->conn, it);
+
+    if (NPOS != index)
+    {
+        return connrec_pack_len(connrecs_get(&r->recs, index));
+    }
+
+    return NPOS;
+}
+
+/**
+ * Entries are written at their mark so a restore starts above every
+ * sequence used here.
+ */
+static size_t
+_trip_snapshot_pack(_trip_router_t *r, size_t it, size_t cap, unsigned char *buf)
+{
+    _trip_connection_t *c = connmap_iter_get(&r->conn, it);
+    connrec_t rec;
+
+    if (c)
+    {
+        memset(&rec, 0, sizeof(rec));
+        _tripc_capture(c, &rec);
+    }
+    else
+    {
+        rec = *connrecs_get(&r->recs, connmap_iter_rec(&r->conn, it));
+    }
+
+    rec.sequence += _TRIPR_SNAPSHOT_RESERVE;
+
+    size_t len = connrec_pack(&rec, cap, buf);
+    sodium_memzero(&rec, sizeof(rec));
+
+    return len;
+}
+
+/**
+ * Set the marks to what _trip_snapshot_pack wrote, or clear them.
+ */
+static void
+_trip_snapshot_mark(_trip_router_t *r, bool on)
+{
+    size_t i = connmap_iter_beg(&r->conn);
+    size_t end = connmap_iter_end(&r->conn);
+
+    for (; i < end; ++i)
+    {
+        if (NPOS == _trip_snapshot_len(r, i))
+        {
+            continue;
+        }
+
+        _trip_connection_t *c = connmap_iter_get(&r->conn, i);
+
+        if (c)
+        {
+            c->cold->seqmark = on ? c->sequence + _TRIPR_SNAPSHOT_RESERVE : 0;
+        }
+        else
+        {
+            connrec_t *rec = connrecs_get(&r->recs, connmap_iter_rec(&r->conn, i));
+            rec->seqmark = on ? rec->sequence + _TRIPR_SNAPSHOT_RESERVE : 0;
+        }
+    }
+}
+
+/**
+ * The file is written beside path and renamed over it once synced, so
+ * path holds either the last snapshot or this one, never a partial file.
+ * @return Zero on success; errno otherwise.
+ */
+static int
+_trip_snapshot_write(_trip_router_t *r, const char *path)
+{
+    static const char HFMT[] = "IHQ";
+    size_t hlen = trip_pack_len(HFMT);
+    size_t total = hlen;
+    size_t i = connmap_iter_beg(&r->conn);
+    size_t end = connmap_iter_end(&r->conn);
+
+    for (; i < end; ++i)
+    {
+        size_t len = _trip_snapshot_len(r, i);
+
+        if (NPOS != len)
+        {
+            total += 4 + len;
+        }
+    }
+
+    size_t plen = strlen(path);
+    char *tmp = tripm_alloc(plen + sizeof(_TRIPR_SNAPSHOT_TMP));
+
+    if (!tmp)
+    {
+        return ENOMEM;
+    }
+
+    memcpy(tmp, path, plen);
+    memcpy(tmp + plen, _TRIPR_SNAPSHOT_TMP, sizeof(_TRIPR_SNAPSHOT_TMP));
+
+    int fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC, 0600);
+
+    if (fd < 0)
+    {
+        int code = errno;
+        tripm_free(tmp);
+        return code;
+    }
+
+    if (ftruncate(fd, (off_t)total))
+    {
+        int code = errno;
+        close(fd);
+        unlink(tmp);
+        tripm_free(tmp);
+        return code;
+    }
+
+    unsigned char *m = mmap(NULL, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    if (MAP_FAILED == m)
+    {
+        int code = errno;
+        close(fd);
+        unlink(tmp);
+        tripm_free(tmp);
+        return code;
+    }
+
+    uint64_t count = 0;
+    size_t off = hlen;
+    int code = 0;
+
+    for (i = connmap_iter_beg(&r->conn); i < end; ++i)
+    {
+        if (NPOS == _trip_snapshot_len(r, i))
+        {
+            continue;
+        }
+
+        size_t len = _trip_snapshot_pack(r, i, total - off - 4, m + off + 4);
+
+        if (NPOS == len)
+        {
+            code = EIO;
+            break;
+        }
+
+        trip_pack(4, m + off, "I", (uint32_t)len);
+        off += 4 + len;
+        ++count;
+    }
+
+    trip_pack(hlen, m, HFMT,
+        (uint32_t)_TRIPR_SNAPSHOT_MAGIC,
+        (uint16_t)_TRIPR_SNAPSHOT_VERSION,
+        count);
+
+    if (!code && msync(m, total, MS_SYNC))
+    {
+        code = errno;
+    }
+
+    munmap(m, total);
+
+    if (!code && fsync(fd))
+    {
+        code = errno;
+    }
+
+    close(fd);
+
+    if (!code && rename(tmp, path))
+    {
+        code = errno;
+    }
+
+    if (code)
+    {
+        unlink(tmp);
+    }
+
+    tripm_free(tmp);
+
+    return code;
+}
+
+static void
+_trip_snapshot_cancel(_trip_router_t *r)
+{
+    if (r->snaptimer)
+    {
+        _trip_cancel_timeout(r->snaptimer);
+        r->snaptimer = NULL;
+    }
+}
+
+/**
+ * Reserve more sequences by writing the snapshot again, ahead of use; if
+ * that fails the snapshot is removed so it can't restore sequences in use.
+ */
+void
+_trip_snapshot_extend(_trip_router_t *r)
+{
+    _trip_snapshot_cancel(r);
+
+    if (r->snappath && !_trip_snapshot_write(r, r->snappath))
+    {
+        _trip_snapshot_mark(r, true);
+        return;
+    }
+
+    if (r->snappath)
+    {
+        unlink(r->snappath);
+        r->snappath = tripm_cfree(r->snappath);
+    }
+
+    _trip_snapshot_mark(r, false);
+}
+
+static void
+_trip_snapshot_cb(void *_r)
+{
+    trip_torouter(r, _r);
+
+    r->snaptimer = NULL;
+    _trip_snapshot_extend(r);
+}
+
+/**
+ * A connection is into the last stretch of its block. The rewrite runs
+ * from a timer, off the send path, once however many ask.
+ */
+void
+_trip_snapshot_due(_trip_router_t *r)
+{
+    if (r->snappath && !r->snaptimer)
+    {
+        r->snaptimer = _trip_set_timeout(r, 0, r, _trip_snapshot_cb);
+    }
+}
+
+/**
+ * Keep the snapshot at path ahead of the connections from now on.
+ * @return Zero on success; ENOMEM otherwise.
+ */
+static int
+_trip_snapshot_keep(_trip_router_t *r, const char *path)
+{
+    if (r->snappath && !strcmp(r->snappath, path))
+    {
+        return 0;
+    }
+
+    char *dup = (char *)tripm_bdup(strlen(path) + 1, (unsigned char *)path);
+
+    if (!dup)
+    {
+        return ENOMEM;
+    }
+
+    if (r->snappath)
+    {
+        /* Only one snapshot is kept ahead; the old one would go stale. */
+        unlink(r->snappath);
+        tripm_free(r->snappath);
+    }
+
+    r->snappath = dup;
+
+    return 0;
+}
+
+/**
+ * @brief Write every ready and hibernated connection to a file so a new
+ * process can resume them with trip_restore.
+ * Each connection is written a block of sequences ahead. The router
+ * writes the file again before any connection uses up its block, so a
+ * restore never reuses a sequence, and nonce, sent under the same keys.
+ * Only the latest path is kept; an earlier one is removed.
+ * @return Zero on success; errno otherwise.
+ */
+int
+trip_snapshot(trip_router_t *_r, const char *path)
+{
+    trip_torouter(r, _r);
+
+    int code = _trip_snapshot_keep(r, path);
+
+    if (code)
+    {
+        return code;
+    }
+
+    code = _trip_snapshot_write(r, path);
+
+    if (!code)
+    {
+        _trip_snapshot_cancel(r);
+        _trip_snapshot_mark(r, true);
+    }
+
+    return code;
+}
+
+/**
+ * @brief Resume connections from trip_snapshot.
+ * The connection hook is called for each one restored so user data can
+ * be attached. The file is written again past the restored sequences
+ * before anything is sent, and kept ahead as with trip_snapshot.
+ * @return Zero on success; errno otherwise.
+ */
+int
+trip_restore(trip_router_t *_r, const char *path)
+{
+    trip_torouter(r, _r);
+
+    static const char HFMT[] = "IHQ";
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0)
+    {
+        return errno;
+    }
+
+    struct stat st;
+
+    if (fstat(fd, &st))
+    {
+        int code = errno;
+        close(fd);
+        return code;
+    }
+
+    size_t total = (size_t)st.st_size;
+
+    if (total < trip_pack_len(HFMT))
+    {
+        close(fd);
+        return EINVAL;
+    }
+
+    unsigned char *m = mmap(NULL, total, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (MAP_FAILED == m)
+    {
+        return errno;
+    }
+
+    uint32_t magic = 0;
+    uint16_t version = 0;
+    uint64_t count = 0;
+    size_t off = trip_unpack(total, m, HFMT, &magic, &version, &count);
+    int code = 0;
+
+    if (NPOS == off
+        || _TRIPR_SNAPSHOT_MAGIC != magic
+        || _TRIPR_SNAPSHOT_VERSION != version)
+    {
+        code = EINVAL;
+    }
+
+    for (; !code && count; --count)
+    {
+        uint32_t len = 0;
+
+        if (NPOS == trip_unpack(total - off, m + off, "I", &len)
+            || len > total - off - 4)
+        {
+            code = EINVAL;
+            break;
+        }
+
+        off += 4;
+
+        connrec_t rec;
+        _trip_connection_t *c = NULL;
+
+        if (NPOS != connrec_unpack(&rec, len, m + off))
+        {
+            c = _trip_restore_rec(r, &rec);
+        }
+
+        if (c)
+        {
+            /* Already at the mark; nothing goes out until it moves. */
+            c->cold->seqmark = c->sequence;
+
+            if (r->connection)
+            {
+                r->connection((trip_connection_t *)c);
+            }
+        }
+
+        off += len;
+    }
+
+    munmap(m, total);
+
+    if (!code)
+    {
+        code = _trip_snapshot_keep(r, path);
+    }
+
+    if (!code)
+    {
+        _trip_snapshot_extend(r);
+    }
+
+    return code;
+}
+
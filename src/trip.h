@@ -35,12 +35,19 @@ extern "C" {
 
 #include "core.h"
 #include "connmap.h"
+#include "connrec.h"
+#include "keepalive.h"
+#include "mpscq.h"
 #include "resolveq.h"
+#include "rxpool.h"
 #include "sendq.h"
+#include "ticket.h"
 #include "sockmap.h"
 #include "trip_poll.h"
 #include "timerwheel.h"
 
+#include <pthread.h>
+
 
 
 typedef struct _trip_router_s _trip_router_t;
@@ -68,9 +75,38 @@ enum _tripr_state
 #define _TRIPR_FLAG_ALLOW_PLAIN_COMM   (1 << 5)
 #define _TRIPR_FLAG_FREE_PACKET        (1 << 6)
 #define _TRIPR_FLAG_ALWAYS_READY       (1 << 7)
+#define _TRIPR_FLAG_RECV_LOAN          (1 << 8)
+#define _TRIPR_FLAG_RUN_EDGE           (1 << 9)
+#define _TRIPR_FLAG_BUSY_SOCKOPT       (1 << 10)
 
 #define _TRIPR_DEFAULT_MAX_CONN (1 << 19)
 #define _TRIPR_DEFAULT_MAX_STREAM (8)
+#define _TRIPR_DEFAULT_STREAM_LOWAT (1 << 14)
+#define _TRIPR_DEFAULT_STREAM_HIWAT (1 << 16)
+#define _TRIPR_DEFAULT_RXPOOL (256)
+#define _TRIPR_DEFAULT_KEEPALIVE (15000)
+/* Segments taken through each stage of trip_seg_batch together. */
+#define _TRIPR_SEG_BATCH (32)
+/* Submissions handled per wake up before yielding to other descriptors. */
+#define _TRIPR_SUBMIT_BATCH (256)
+
+/* Router snapshot file header. */
+#define _TRIPR_SNAPSHOT_MAGIC (0x54525053)
+#define _TRIPR_SNAPSHOT_VERSION (1)
+/* Suffix of the file a snapshot is written to before the rename. */
+#define _TRIPR_SNAPSHOT_TMP ".tmp"
+/* Connections restored from tripc_serialize skip ahead so no sequence,
+ * and nonce, is reused for packets the old side sent after the blob.
+ */
+#define _TRIPR_RESTORE_SEQ_SKIP (1 << 16)
+/* Sequences a snapshot reserves per connection; connections restore at
+ * the mark and the snapshot is written again before any passes it.
+ */
+#define _TRIPR_SNAPSHOT_RESERVE (1 << 20)
+/* Left of a connection's block when the rewrite is scheduled; only one
+ * that reaches the mark itself waits for it.
+ */
+#define _TRIPR_SNAPSHOT_EARLY (_TRIPR_SNAPSHOT_RESERVE / 2)
 
 // TODO fix this, we should update zones when we get to large offset
 // TODO deprecated already...
@@ -79,6 +115,38 @@ enum _tripr_state
 
 
 
+enum _trip_submit_kind
+{
+    _TRIP_SUBMIT_SEND,
+    _TRIP_SUBMIT_SENDV,
+    _TRIP_SUBMIT_OPEN,
+};
+
+/**
+ * A call made off the owning thread, replayed by the router thread.
+ * Streams are found again by reference in case they closed while the
+ * submission was queued; the stream pointer is never kept.
+ */
+typedef struct _trip_submit_s
+{
+    mpscq_node_t node;
+    enum _trip_submit_kind kind;
+
+    /* SEND and SENDV. */
+    trip_streamref_t ref;
+    size_t len;
+    const unsigned char *buf;
+    struct iovec *iov;
+    int iovcnt;
+    trip_handle_release_t *release;
+    void *ctx;
+
+    /* OPEN. */
+    void *data;
+    size_t ilen;
+    unsigned char *info;
+} _trip_submit_t;
+
 struct _trip_router_s
 {
     /* Frequently Accessed */
@@ -91,6 +159,8 @@ struct _trip_router_s
     trip_handle_connection_t *connection;
     trip_handle_stream_t *stream;
     trip_handle_message_t *message;
+    trip_handle_stream_t *writable;
+    trip_handle_hibernate_t *hibernate;
 
     /* Wait Data */
     _trip_poll_t *poll;
@@ -109,19 +179,48 @@ struct _trip_router_s
 
     /* Connections. */
     connmap_t conn;
+    /* Hibernated connections, referenced from conn. */
+    connrecs_t recs;
     // TODO create real datastructure, src should be easily indexed...
     _trip_connection_t *connsrc[2];
 
     /* Socket map. */
     sockmap_t sockmap;
 
-    /* Send Management */
+    /* Keepalives of ready connections, swept by katimer when the earliest
+     * occupied slot is due at kadeadline.
+     */
+    keepalive_t keepalive;
+    timer_entry_t *katimer;
+    uint64_t kadeadline;
+    int keepalivems;
+
+    /* Calls from other threads; subfd is an eventfd watched like a socket. */
+    mpscq_t submitq;
+    int subfd;
+    pthread_t owner;
+    bool owned;
+
+    /* Last stream generation handed out; zero is never valid. */
+    uint64_t streamgen;
+
+    /* Send Management
+     * Sends are flushed when the outermost entry point returns; txfd is
+     * watched for TRIP_OUT only while sends are left over.
+     */
+    int depth;
+    timer_entry_t *sendtimer;
+    trip_socket_t txfd;
+    int txevents;
     sendq_t sendq;
     unsigned char *buf;
     size_t buflen;
     size_t sendlen; // set when the buffer has a packet to send
     int sendsrc;
 
+    /* Receive Buffers */
+    rxpool_t rxpool;
+
     /* Packet Interface */
     trip_packet_t *packet;
 
@@ -135,6 +234,22 @@ struct _trip_router_s
     unsigned char *signpub;
     unsigned char *signsec;
 
+    /* Resumption tickets; zero lifetime disables issuing. */
+    int ticketms;
+    unsigned char ticketkey[_TICKET_KEY];
+    ticketreplay_t replay;
+
+    /* Last snapshot, kept ahead of the sequences in use; NULL if none.
+     * snaptimer rewrites it once a connection is into its last stretch.
+     */
+    char *snappath;
+    timer_entry_t *snaptimer;
+
+    /* Rekey after this much sent; zero never. Overlap of old keys. */
+    uint64_t renewbytes;
+    uint64_t renewpackets;
+    int renewms;
+
     /* Limits */
     //limits_t lim; // TODO move below to limits structure
     uint32_t max_conn;// TODO use uppermost bits on max_conn for connection ID randomization??
@@ -142,8 +257,17 @@ struct _trip_router_s
     uint32_t max_out;
     uint32_t max_packet_read_count;
     uint32_t max_packet_send_count;
-    uint32_t max_connection_send_count;
     uint32_t max_streams;
+    /* Queued bytes per stream before backflow, and when it is lifted. */
+    size_t stream_lowat;
+    size_t stream_hiwat;
+    /* Segment size assumed to work, and the most path MTU discovery tries. */
+    size_t basepmtu;
+    size_t maxpmtu;
+    /* Idle milliseconds before a connection hibernates; zero never. */
+    int hibernatems;
+    /* Microseconds trip_run spins after activity before sleeping. */
+    int busypollus;
 
     // TODO move to own struct
     int timeout_data;
@@ -155,10 +279,24 @@ struct _trip_router_s
     uint32_t flag;
 };
 
+bool
+_trip_has_send(_trip_router_t *r);
 void
 _trip_close_connection(_trip_router_t *r, _trip_connection_t *c);
+bool
+_trip_hibernate(_trip_router_t *r, _trip_connection_t *c);
+void
+_trip_keepalive(_trip_router_t *r, _trip_connection_t *c, uint64_t when);
+void
+_trip_snapshot_extend(_trip_router_t *r);
+void
+_trip_snapshot_due(_trip_router_t *r);
 void
 _trip_set_state(_trip_router_t *r, enum _tripr_state state);
+bool
+_trip_is_owner(_trip_router_t *r);
+int
+_trip_submit(_trip_router_t *r, _trip_submit_t *sub);
 void
 _trip_qconnection(_trip_router_t *r, _trip_connection_t *c);
 void
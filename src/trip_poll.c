@@ -2,7 +2,11 @@
 #include "trip_poll.h"
 
 #include <errno.h>
+#include <limits.h>
 #include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
 #include <string.h>
 
 #include "time.h"
@@ -31,13 +35,33 @@ _trip_poll_new()
 
     w->efd = epoll_create1(0);
     w->deadline = triptime_now();
+    w->spinuntil = 0;
+    w->againlen = 0;
     if (-1 == w->efd)
     {
         c = EINVAL;
     }
 
+    /* Timer deadlines are realtime milliseconds, see triptime_now. */
+    w->tfd = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (!c && -1 != w->tfd)
+    {
+        struct epoll_event ev = { 0 };
+        ev.events = EPOLLIN;
+        ev.data.fd = w->tfd;
+        if (epoll_ctl(w->efd, EPOLL_CTL_ADD, w->tfd, &ev))
+        {
+            close(w->tfd);
+            w->tfd = -1;
+        }
+    }
+
     if (c)
     {
+        if (-1 != w->tfd)
+        {
+            close(w->tfd);
+        }
         if (w)
         {
             tripm_free(w);
@@ -48,6 +72,20 @@ _trip_poll_new()
     return w;
 }
 
+void
+_trip_poll_free(_trip_poll_t *w)
+{
+    if (w)
+    {
+        if (-1 != w->tfd)
+        {
+            close(w->tfd);
+        }
+        close(w->efd);
+        tripm_free(w);
+    }
+}
+
 static int
 _trip_fd_events_to_epoll(int events)
 {
@@ -76,14 +114,55 @@ _trip_fd_events_to_epoll(int events)
     return eout;
 }
 
+/**
+ * @brief Arm the timerfd to an absolute deadline; TRIPTIME_END disarms.
+ */
+static void
+_trip_poll_arm(_trip_poll_t *w, uint64_t deadline)
+{
+    struct itimerspec its = { 0 };
+
+    if (TRIPTIME_END != deadline)
+    {
+        /* Zero would disarm; a past deadline fires at once. */
+        deadline = deadline ? deadline : 1;
+        its.it_value.tv_sec = (time_t)(deadline / 1000);
+        its.it_value.tv_nsec = (long)(deadline % 1000) * 1000000;
+    }
+
+    timerfd_settime(w->tfd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
 /**
  * @return The next timeout for the next call to epoll.
  *
+ * With a timerfd only the caller's deadline bounds the wait.
+ *
  * TODO there must be a better way... so many ifs...
  */
 static int
 next_timeout(_trip_poll_t *poll, uint64_t deadline, uint64_t now)
 {
+    if (-1 != poll->tfd)
+    {
+        if (TRIPTIME_END == deadline)
+        {
+            return -1;
+        }
+        else if (deadline <= now)
+        {
+            return 0;
+        }
+        else if (deadline - now >= INT_MAX)
+        {
+            return INT_MAX;
+        }
+        else
+        {
+            return (int)(deadline - now);
+        }
+    }
+
     if (deadline < poll->deadline)
     {
         if (deadline <= now)
@@ -117,6 +196,91 @@ next_timeout(_trip_poll_t *poll, uint64_t deadline, uint64_t now)
     }
 }
 
+/**
+ * Edge-triggered only: replay a writable descriptor while the router has
+ * more to send and its last send did not block.
+ */
+static void
+_trip_poll_again(_trip_router_t *r, _trip_poll_t *w, int fd)
+{
+    if (!(r->flag & _TRIPR_FLAG_RUN_EDGE)
+        || r->sendlen
+        || !_trip_has_send(r)
+        || w->againlen >= _TRIP_MAX_EVENTS)
+    {
+        return;
+    }
+
+    int i;
+    for (i = 0; i < w->againlen; ++i)
+    {
+        if (fd == w->again[i])
+        {
+            return;
+        }
+    }
+
+    w->again[w->againlen++] = fd;
+}
+
+/**
+ * Wait for events, first spinning with a zero timeout while busy polling
+ * and there was activity in the last busypollus microseconds.
+ * @return As epoll_wait.
+ */
+static int
+_trip_poll_wait(_trip_router_t *r, _trip_poll_t *w,
+                struct epoll_event *eventlist, int timeout)
+{
+    int nfds = 0;
+
+    if (w->againlen)
+    {
+        /* Replayed sends are due now. */
+        timeout = 0;
+    }
+
+    if (r->busypollus > 0 && timeout)
+    {
+        uint64_t start = triptime_now_us();
+        uint64_t now = start;
+        uint64_t until = w->spinuntil;
+
+        if (timeout > 0 && start + (uint64_t)timeout * 1000 < until)
+        {
+            until = start + (uint64_t)timeout * 1000;
+        }
+
+        while (now < until)
+        {
+            nfds = epoll_wait(w->efd, eventlist, _TRIP_MAX_EVENTS, 0);
+            if (nfds)
+            {
+                break;
+            }
+            now = triptime_now_us();
+        }
+
+        if (!nfds && timeout > 0)
+        {
+            int spent = (int)((now - start) / 1000);
+            timeout = spent >= timeout ? 0 : timeout - spent;
+        }
+    }
+
+    if (!nfds)
+    {
+        nfds = epoll_wait(w->efd, eventlist, _TRIP_MAX_EVENTS, timeout);
+    }
+
+    if (nfds > 0 && r->busypollus > 0)
+    {
+        w->spinuntil = triptime_now_us() + (uint64_t)r->busypollus;
+    }
+
+    return nfds;
+}
+
 void
 _trip_watch_cb(trip_router_t *_r, int fd, int events, void * UNUSED(data))
 {
@@ -129,13 +293,25 @@ _trip_watch_cb(trip_router_t *_r, int fd, int events, void * UNUSED(data))
     ev.events = _trip_fd_events_to_epoll(events);
     ev.data.fd = fd;
 
+    if (r->flag & _TRIPR_FLAG_RUN_EDGE)
+    {
+        /* The router reads until EAGAIN; trip_run replays short sends. */
+        ev.events |= EPOLLET;
+    }
+
     if (TRIP_REMOVE != events)
     {
         c = epoll_ctl(w->efd, EPOLL_CTL_ADD, fd, &ev);
-        if (EEXIST == c)
+        if (-1 == c && EEXIST == errno)
         {
             c = epoll_ctl(w->efd, EPOLL_CTL_MOD, fd, &ev);
         }
+        else if (!c && (r->flag & _TRIPR_FLAG_BUSY_SOCKOPT))
+        {
+            /* Only a hint; fails on non-sockets or without privilege. */
+            setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL,
+                       &r->busypollus, sizeof(r->busypollus));
+        }
     }
     else
     {
@@ -152,6 +328,8 @@ _trip_watch_cb(trip_router_t *_r, int fd, int events, void * UNUSED(data))
 
 /**
  * The framework should always be giving the nearest timeout.
+ * The timerfd takes the router's deadline as is, since the timeout given
+ * is clamped to _TRIPR_MAX_TIMEOUT.
  */
 void
 _trip_timeout_cb(trip_router_t *_r, long timeout)
@@ -159,6 +337,11 @@ _trip_timeout_cb(trip_router_t *_r, long timeout)
     trip_torouter(r, _r);
     _trip_poll_t *w = r->poll;
     w->deadline = triptime_deadline(timeout);
+
+    if (-1 != w->tfd)
+    {
+        _trip_poll_arm(w, r->mindeadline);
+    }
 }
 
 /**
@@ -243,7 +426,27 @@ trip_run(trip_router_t *_r, int timeout)
 #endif
             /* Call epoll. */
             struct epoll_event eventlist[_TRIP_MAX_EVENTS];
-            int nfds = epoll_wait(w->efd, eventlist, _TRIP_MAX_EVENTS, timeout);
+            int nfds = _trip_poll_wait(r, w, eventlist, timeout);
+
+            /* Writable edges already consumed; the router stopped at its
+             * send limit so no new edge comes until we send again.
+             */
+            int again[_TRIP_MAX_EVENTS];
+            int againlen = w->againlen;
+            memcpy(again, w->again, sizeof(int) * againlen);
+            w->againlen = 0;
+
+            int n;
+            for (n = 0; n < againlen && !c; ++n)
+            {
+                c = trip_action(_r, again[n], TRIP_OUT);
+                _trip_poll_again(r, w, again[n]);
+            }
+
+            if (c)
+            {
+                break;
+            }
 
             if (-1 == nfds)
             {
@@ -259,13 +462,29 @@ trip_run(trip_router_t *_r, int timeout)
             else
             {
                 /* Call action for each file descriptor. */
-                int n;
                 for (n = 0; n < nfds; ++n)
                 {
                     int events = 0;
                     int evs = eventlist[n].events;
                     int fd = eventlist[n].data.fd;
 
+                    if (fd == w->tfd)
+                    {
+                        uint64_t expired;
+                        if (-1 == read(w->tfd, &expired, sizeof(expired)))
+                        {
+                            /* EAGAIN, rearmed since it fired. */
+                            continue;
+                        }
+
+                        c = trip_timeout(_r);
+                        if (c)
+                        {
+                            break;
+                        }
+                        continue;
+                    }
+
                     if (evs & EPOLLIN)
                     {
                         events |= TRIP_IN;
@@ -282,6 +501,11 @@ trip_run(trip_router_t *_r, int timeout)
                     {
                         break;
                     }
+
+                    if (events & TRIP_OUT)
+                    {
+                        _trip_poll_again(r, w, fd);
+                    }
                 }
             }
 
@@ -38,9 +38,19 @@ extern "C" {
 typedef struct _trip_poll_s
 {
     int efd;
+    /* Armed to the router's earliest deadline; -1 falls back to deadline. */
+    int tfd;
     uint64_t deadline;
+    /* Busy polling continues until this monotonic microsecond. */
+    uint64_t spinuntil;
+    /* Edge-triggered descriptors that stopped sending before EAGAIN. */
+    int again[_TRIP_MAX_EVENTS];
+    int againlen;
 } _trip_poll_t;
 
+void
+_trip_poll_free(_trip_poll_t *w);
+
 
 #ifdef __cplusplus
 }
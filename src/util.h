@@ -48,11 +48,15 @@ extern "C" {
 #ifdef __GNUC__
 #define LIKELY(x)   __builtin_expect(!!(x), 1)
 #define UNLIKELY(x) __builtin_expect(!!(x), 0)
+#define PREFETCH(p) __builtin_prefetch((p))
 #else
 #define LIKELY(x)   (x)
 #define UNLIKELY(x) (x)
+#define PREFETCH(p) ((void)(p))
 #endif
 
+#define CACHE_LINE (64)
+
 #ifndef NPOS
 #define NPOS ((size_t)-1)
 #endif
@@ -53,9 +53,9 @@ client_handle_connection(trip_connection_t *c)
     {
         case TRIPC_STATUS_OPEN:
             {
-                int opts = TRIPS_OPT_PRIORITY | TRIPS_OPT_CHUNK
+                int opts = TRIPS_OPT_CHUNK
                            | TRIPS_OPT_ORDERED | TRIPS_OPT_RELIABLE;
-                trip_stream_t *s = tripc_open_stream(c, 0, opts);
+                trip_stream_t *s = tripc_open_stream(c, 0, 0, opts);
                 const char *msg = "Hello, world!";
                 size_t len = strlen(msg);
                 trips_send(s, len, (const unsigned char *)msg);
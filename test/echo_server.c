@@ -139,7 +139,7 @@ server_handle_message(trip_stream_t *s, enum trip_message_status status, size_t
                 if (!stream)
                 {
                     trip_connection_t *c = s->connection;
-                    stream = tripc_open_stream(c, trips_id(s), trips_type(s));
+                    stream = tripc_open_stream(c, trips_id(s), trips_priority(s), trips_type(s));
                     s->data = stream;
                 }
 
@@ -103,10 +103,9 @@ router_handle_connection(trip_connection_t *c)
                 /* Sweet, we have a connection out. */
                 if (!c->data)
                 {
-                    int opts = TRIPS_OPT_PRIORITY
-                        | TRIPS_OPT_ORDERED
+                    int opts = TRIPS_OPT_ORDERED
                         | TRIPS_OPT_RELIABLE;
-                    c->data = tripc_open_stream(c, 0, opts);
+                    c->data = tripc_open_stream(c, 0, 0, opts);
                     trips_send(c->data, MSGLEN, MSG);
                 }
             }
@@ -177,7 +176,7 @@ router_handle_message(trip_stream_t *s, enum trip_message_status status, size_t
                 if (!stream)
                 {
                     trip_connection_t *c = s->connection;
-                    stream = tripc_open_stream(c, trips_id(s), trips_type(s));
+                    stream = tripc_open_stream(c, trips_id(s), trips_priority(s), trips_type(s));
                     s->data = stream;
                 }
 
@@ -0,0 +1,131 @@
+
+#include "libtrp.h"
+#include "../../src/conn.h"
+#include "../../src/connmap.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+
+
+#define CONNS (1024)
+#define ROUNDS (200000)
+/* Free list link for none, as stored in the entry's ID. */
+#define NIL ((uint64_t)0xFFFFFFFF)
+
+static _trip_connection_t conns[CONNS];
+static bool used[CONNS];
+
+static size_t
+link_index(uint64_t link)
+{
+    return NIL == link ? NPOS : (size_t)link;
+}
+
+/**
+ * Every handed out slot is either live or on the free list, and the
+ * list's back links match its forward ones.
+ */
+static void
+check_free(connmap_t *m)
+{
+    size_t n = 0;
+    size_t prev = NPOS;
+
+    for (size_t f = m->free; NPOS != f; ++n)
+    {
+        connmap_entry_t *e = &m->map[f];
+        assert(f < m->top);
+        assert(0 == e->ref);
+        assert(prev == link_index(e->id >> 32));
+        prev = f;
+        f = link_index(e->id & NIL);
+    }
+
+    assert(n + m->size == m->top);
+}
+
+/**
+ * Adds with fresh IDs, adds under given IDs and deletes, at random.
+ */
+static void
+test_random(void)
+{
+    connmap_t m;
+    connmap_init(&m, CONNS);
+    srand(7);
+
+    for (int round = 0; round < ROUNDS; ++round)
+    {
+        int op = rand() % 3;
+        int k = rand() % CONNS;
+        _trip_connection_t *c = &conns[k];
+
+        if (0 == op && !used[k])
+        {
+            used[k] = !connmap_add(&m, c);
+        }
+        else if (1 == op && !used[k])
+        {
+            uint64_t id = ((uint64_t)rand() << 20) | (uint64_t)(rand() % CONNS);
+            int code = connmap_add_id(&m, c, id);
+            assert(!code || EEXIST == code);
+            used[k] = !code;
+        }
+        else if (2 == op && used[k])
+        {
+            assert(c == connmap_del(&m, c->id));
+            assert(NULL == connmap_get(&m, c->id));
+            used[k] = false;
+        }
+
+        check_free(&m);
+    }
+
+    size_t n = 0;
+    for (int k = 0; k < CONNS; ++k)
+    {
+        if (used[k])
+        {
+            assert(&conns[k] == connmap_get(&m, conns[k].id));
+            ++n;
+        }
+    }
+    assert(n == m.size);
+
+    connmap_destroy(&m);
+}
+
+static void
+test_full(void)
+{
+    connmap_t m;
+    connmap_init(&m, CONNS);
+
+    for (int k = 0; k < CONNS; ++k)
+    {
+        assert(0 == connmap_add(&m, &conns[k]));
+    }
+    _trip_connection_t extra;
+    assert(ENOSPC == connmap_add(&m, &extra));
+    assert(EEXIST == connmap_add_id(&m, &extra, conns[3].id));
+
+    /* A stale ID for a reused slot misses. */
+    uint64_t old = conns[3].id;
+    assert(&conns[3] == connmap_del(&m, old));
+    assert(0 == connmap_add_id(&m, &extra, old ^ ((uint64_t)1 << 40)));
+    assert(NULL == connmap_get(&m, old));
+    assert(NULL == connmap_del(&m, old));
+    assert(&extra == connmap_get(&m, extra.id));
+
+    connmap_destroy(&m);
+}
+
+int
+main()
+{
+    test_random();
+    test_full();
+
+    return 0;
+}
@@ -0,0 +1,123 @@
+
+#include "libtrp.h"
+#include "../../src/connrec.h"
+#include "../../src/util.h"
+
+#include <assert.h>
+#include <string.h>
+
+
+static unsigned char info[] = "host:port";
+static unsigned char route[] = { 1, 2, 3 };
+static unsigned char ticket[] = { 9, 8, 7, 6, 5 };
+
+static void
+fill(connrec_t *rec)
+{
+    memset(rec, 0, sizeof(*rec));
+    rec->id = 0x0102030405060708ULL;
+    rec->peerid = 0x1122334455667788ULL;
+    rec->sequence = 1ULL << 40;
+    rec->seqfloor = 77;
+    rec->seqmark = 123;
+    rec->window = 0xFFFF0000;
+    rec->weight = 3;
+    rec->src = 5;
+    rec->pingms = 100;
+    rec->pingmaxms = -1;
+    rec->flags = _CONNREC_USED | _CONNREC_INCOMING | _CONNREC_ENCRYPTED
+               | _CONNREC_SELF_PK | _CONNREC_PEER_NONCE;
+    rec->selflim = (connlim_t){ 1, 2, 3, 4 };
+    rec->peerlim = (connlim_t){ 5, 6, 7, 8 };
+    rec->data = rec;
+
+    memset(rec->selfpk, 0x11, sizeof(rec->selfpk));
+    memset(rec->selfsk, 0x22, sizeof(rec->selfsk));
+    memset(rec->selfnonce, 0x33, sizeof(rec->selfnonce));
+    memset(rec->peerpk, 0x44, sizeof(rec->peerpk));
+    memset(rec->peernonce, 0x55, sizeof(rec->peernonce));
+    memset(rec->ticketsecret, 0x66, sizeof(rec->ticketsecret));
+
+    rec->ilen = sizeof(info);
+    rec->info = info;
+    rec->rlen = sizeof(route);
+    rec->route = route;
+    rec->ticketlen = sizeof(ticket);
+    rec->ticket = ticket;
+}
+
+static void
+test_roundtrip(void)
+{
+    connrec_t rec;
+    fill(&rec);
+
+    unsigned char buf[1024];
+    size_t len = connrec_pack(&rec, sizeof(buf), buf);
+    assert(NPOS != len);
+    assert(connrec_pack_len(&rec) == len);
+
+    connrec_t out;
+    assert(len == connrec_unpack(&out, len, buf));
+
+    assert(rec.id == out.id);
+    assert(rec.peerid == out.peerid);
+    assert(rec.sequence == out.sequence);
+    assert(rec.seqfloor == out.seqfloor);
+    assert(rec.window == out.window);
+    assert(rec.weight == out.weight);
+    assert(rec.pingms == out.pingms);
+    assert(rec.pingmaxms == out.pingmaxms);
+    assert(rec.flags == out.flags);
+    assert(!memcmp(&rec.selflim, &out.selflim, sizeof(connlim_t)));
+    assert(!memcmp(&rec.peerlim, &out.peerlim, sizeof(connlim_t)));
+    assert(!memcmp(rec.selfpk, out.selfpk, sizeof(rec.selfpk)));
+    assert(!memcmp(rec.selfsk, out.selfsk, sizeof(rec.selfsk)));
+    assert(!memcmp(rec.selfnonce, out.selfnonce, sizeof(rec.selfnonce)));
+    assert(!memcmp(rec.peerpk, out.peerpk, sizeof(rec.peerpk)));
+    assert(!memcmp(rec.peernonce, out.peernonce, sizeof(rec.peernonce)));
+    assert(!memcmp(rec.ticketsecret, out.ticketsecret, sizeof(rec.ticketsecret)));
+
+    /* Owned copies. */
+    assert(rec.ilen == out.ilen && out.info != info);
+    assert(!memcmp(info, out.info, sizeof(info)));
+    assert(rec.rlen == out.rlen && !memcmp(route, out.route, sizeof(route)));
+    assert(rec.ticketlen == out.ticketlen && !memcmp(ticket, out.ticket, sizeof(ticket)));
+
+    /* Live only: the source, the snapshot mark and user pointers. */
+    assert(-1 == out.src);
+    assert(0 == out.seqmark);
+    assert(NULL == out.data);
+
+    connrec_clear(&out);
+}
+
+static void
+test_invalid(void)
+{
+    connrec_t rec;
+    fill(&rec);
+
+    unsigned char buf[1024];
+    size_t len = connrec_pack(&rec, sizeof(buf), buf);
+    assert(NPOS == connrec_pack(&rec, len - 1, buf));
+
+    connrec_t out;
+
+    /* Truncated, in the fields or in the trailing bytes. */
+    assert(NPOS == connrec_unpack(&out, len - 1, buf));
+    assert(NPOS == connrec_unpack(&out, 10, buf));
+
+    /* Another version. */
+    buf[1] ^= 0xFF;
+    assert(NPOS == connrec_unpack(&out, len, buf));
+}
+
+int
+main()
+{
+    test_roundtrip();
+    test_invalid();
+
+    return 0;
+}
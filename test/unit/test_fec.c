@@ -0,0 +1,142 @@
+
+#include "libtrp.h"
+#include "../../src/fec.h"
+#include "../../src/util.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+
+
+#define K (4)
+#define CAP (64)
+
+static unsigned char seg[K][CAP];
+static size_t seglen[K] = { 64, 17, 40, 1 };
+
+static size_t
+encode(unsigned char *repair)
+{
+    fec_t enc;
+    assert(0 == fec_init(&enc, K, CAP));
+
+    int i;
+    for (i = 0; i < K; ++i)
+    {
+        assert(!fec_enc_full(&enc));
+        assert(0 == fec_enc_add(&enc, seglen[i], seg[i]));
+    }
+    assert(fec_enc_full(&enc));
+
+    size_t rlen = fec_enc_repair(&enc, repair);
+    assert(rlen >= 2 && rlen <= CAP + 2);
+    assert(1 == enc.group);
+    assert(!fec_enc_full(&enc));
+
+    fec_destroy(&enc);
+
+    return rlen;
+}
+
+static void
+test_recover(void)
+{
+    unsigned char repair[CAP + 2];
+    size_t rlen = encode(repair);
+
+    uint32_t lost;
+    for (lost = 0; lost < K; ++lost)
+    {
+        fec_t dec;
+        assert(0 == fec_init(&dec, K, CAP));
+
+        uint32_t i;
+        for (i = 0; i < K; ++i)
+        {
+            if (i != lost)
+            {
+                assert(0 == fec_dec_add(&dec, 0, i, seglen[i], seg[i]));
+            }
+        }
+        assert(0 == fec_dec_add(&dec, 0, K, rlen, repair));
+
+        unsigned char out[CAP];
+        uint32_t index = K;
+        size_t len = fec_dec_recover(&dec, &index, out);
+
+        assert(lost == index);
+        assert(seglen[lost] == len);
+        assert(!memcmp(out, seg[lost], len));
+
+        /* Nothing left to rebuild. */
+        assert(NPOS == fec_dec_recover(&dec, &index, out));
+
+        fec_destroy(&dec);
+    }
+}
+
+static void
+test_unrecoverable(void)
+{
+    unsigned char repair[CAP + 2];
+    size_t rlen = encode(repair);
+    unsigned char out[CAP];
+    uint32_t index;
+
+    fec_t dec;
+    assert(0 == fec_init(&dec, K, CAP));
+
+    /* Two lost. */
+    assert(0 == fec_dec_add(&dec, 0, 0, seglen[0], seg[0]));
+    assert(0 == fec_dec_add(&dec, 0, 1, seglen[1], seg[1]));
+    assert(0 == fec_dec_add(&dec, 0, K, rlen, repair));
+    assert(NPOS == fec_dec_recover(&dec, &index, out));
+
+    /* Duplicates and bad positions are refused. */
+    assert(EINVAL == fec_dec_add(&dec, 0, 0, seglen[0], seg[0]));
+    assert(EINVAL == fec_dec_add(&dec, 0, K, rlen, repair));
+    assert(EINVAL == fec_dec_add(&dec, 0, K + 1, 1, seg[0]));
+
+    /* A later group moves on; an earlier one is stale. */
+    assert(0 == fec_dec_add(&dec, 2, 0, seglen[0], seg[0]));
+    assert(ESTALE == fec_dec_add(&dec, 1, 0, seglen[0], seg[0]));
+
+    fec_destroy(&dec);
+}
+
+static void
+test_oversize(void)
+{
+    fec_t enc;
+    unsigned char big[CAP + 1];
+    memset(big, 0xAB, sizeof(big));
+
+    assert(0 == fec_init(&enc, K, CAP));
+    assert(EMSGSIZE == fec_enc_add(&enc, CAP + 1, big));
+    assert(0 == enc.seen);
+    assert(0 == fec_enc_add(&enc, CAP, big));
+    fec_destroy(&enc);
+
+    assert(EINVAL == fec_init(&enc, 0, CAP));
+    assert(EINVAL == fec_init(&enc, _TRIP_FEC_MAX_K + 1, CAP));
+}
+
+int
+main()
+{
+    int i;
+    size_t j;
+    for (i = 0; i < K; ++i)
+    {
+        for (j = 0; j < seglen[i]; ++j)
+        {
+            seg[i][j] = (unsigned char)(i * 31 + j * 7 + 1);
+        }
+    }
+
+    test_recover();
+    test_unrecoverable();
+    test_oversize();
+
+    return 0;
+}
@@ -0,0 +1,123 @@
+
+#include "libtrp.h"
+#include "../../src/conn.h"
+#include "../../src/keepalive.h"
+#include "../../src/time.h"
+
+#include <assert.h>
+
+
+#define CONNS (2000)
+#define START (100000)
+
+static _trip_connection_t conns[CONNS];
+
+static void
+test_next(void)
+{
+    keepalive_t k;
+    keepalive_init(&k, START);
+    assert(TRIPTIME_END == keepalive_next(&k));
+
+    /* The end of the tick it falls in. */
+    _trip_connection_t a = { 0 };
+    keepalive_add(&k, &a, START + 250);
+    assert(START + 300 == keepalive_next(&k));
+
+    /* Already passed, so due in the current tick. */
+    _trip_connection_t b = { 0 };
+    keepalive_add(&k, &b, START - 5000);
+    assert(START + 100 == keepalive_next(&k));
+
+    keepalive_del(&k, &b);
+    assert(START + 300 == keepalive_next(&k));
+    keepalive_del(&k, &a);
+    assert(TRIPTIME_END == keepalive_next(&k));
+    assert(0 == k.size);
+}
+
+/**
+ * Half due shortly, half over a lap out; only the first half is popped,
+ * including across a delete of the sweep's cursor.
+ */
+static void
+test_sweep(void)
+{
+    keepalive_t k;
+    keepalive_init(&k, START);
+
+    for (int i = 0; i < CONNS; ++i)
+    {
+        uint64_t when = START + (uint64_t)(i % 50) * 10;
+        keepalive_add(&k, &conns[i], when + (i >= CONNS / 2 ? 60000 : 0));
+    }
+    assert(START + 100 == keepalive_next(&k));
+
+    uint64_t now = START + 600;
+    int n = 0;
+    _trip_connection_t *c;
+    while ((c = keepalive_pop(&k, now)))
+    {
+        assert(c->kawhen <= now);
+        assert(!c->inka);
+
+        if (10 == ++n)
+        {
+            assert(k.cursor);
+            keepalive_del(&k, k.cursor);
+        }
+    }
+    assert(CONNS / 2 - 1 == n);
+    assert(CONNS / 2 == k.size);
+
+    /* Woken a lap early for the far ones, which are skipped. */
+    uint64_t next = keepalive_next(&k);
+    assert(next > now && next < START + 60000);
+    assert(NULL == keepalive_pop(&k, next));
+
+    n = 0;
+    while ((c = keepalive_pop(&k, START + 61000)))
+    {
+        ++n;
+    }
+    assert(CONNS / 2 == n);
+    assert(0 == k.size);
+    assert(TRIPTIME_END == keepalive_next(&k));
+}
+
+/**
+ * Filed again into the slot being swept, it waits for the next sweep.
+ */
+static void
+test_refile(void)
+{
+    keepalive_t k;
+    keepalive_init(&k, START);
+
+    _trip_connection_t a = { 0 };
+    _trip_connection_t b = { 0 };
+    keepalive_add(&k, &a, START);
+    keepalive_add(&k, &b, START);
+
+    _trip_connection_t *c = keepalive_pop(&k, START);
+    assert(c);
+    keepalive_add(&k, c, START);
+
+    _trip_connection_t *d = keepalive_pop(&k, START);
+    assert(d && d != c);
+    assert(NULL == keepalive_pop(&k, START));
+
+    assert(c == keepalive_pop(&k, START));
+    assert(NULL == keepalive_pop(&k, START));
+    assert(0 == k.size);
+}
+
+int
+main()
+{
+    test_next();
+    test_sweep();
+    test_refile();
+
+    return 0;
+}
@@ -0,0 +1,154 @@
+
+#include "libtrp.h"
+#include "../../src/mpscq.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+
+
+#define PRODUCERS (4)
+#define PER_PRODUCER (100000)
+
+typedef struct item_s
+{
+    mpscq_node_t node;
+    int producer;
+    int seq;
+} item_t;
+
+static mpscq_t q;
+static item_t items[PRODUCERS][PER_PRODUCER];
+
+/* Stands in for the router's eventfd. */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+static int wakes = 0;
+
+static void
+wake(void)
+{
+    pthread_mutex_lock(&lock);
+    ++wakes;
+    pthread_cond_signal(&cond);
+    pthread_mutex_unlock(&lock);
+}
+
+/**
+ * Sleep until woken; a lost wake up would hang here, so give up loudly.
+ */
+static void
+sleep_for_wake(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += 10;
+
+    pthread_mutex_lock(&lock);
+    while (!wakes)
+    {
+        int code = pthread_cond_timedwait(&cond, &lock, &ts);
+        assert(0 == code);
+    }
+    wakes = 0;
+    pthread_mutex_unlock(&lock);
+}
+
+static void *
+produce(void *arg)
+{
+    int p = (int)(intptr_t)arg;
+    int i;
+
+    for (i = 0; i < PER_PRODUCER; ++i)
+    {
+        items[p][i].producer = p;
+        items[p][i].seq = i;
+
+        if (mpscq_push(&q, &items[p][i].node))
+        {
+            wake();
+        }
+    }
+
+    return NULL;
+}
+
+static void
+test_single(void)
+{
+    item_t a, b;
+
+    mpscq_init(&q);
+    assert(mpscq_empty(&q));
+    assert(NULL == mpscq_pop(&q));
+
+    /* Only the push onto an empty queue asks for a wake up. */
+    assert(mpscq_push(&q, &a.node));
+    assert(!mpscq_push(&q, &b.node));
+    assert(!mpscq_empty(&q));
+
+    assert(&a.node == mpscq_pop(&q));
+    assert(&b.node == mpscq_pop(&q));
+    assert(NULL == mpscq_pop(&q));
+    assert(mpscq_empty(&q));
+
+    assert(mpscq_push(&q, &a.node));
+    assert(&a.node == mpscq_pop(&q));
+    assert(mpscq_empty(&q));
+}
+
+static void
+test_threads(void)
+{
+    pthread_t threads[PRODUCERS];
+    int next[PRODUCERS] = { 0 };
+    int count = 0;
+    int p;
+
+    mpscq_init(&q);
+
+    for (p = 0; p < PRODUCERS; ++p)
+    {
+        assert(0 == pthread_create(&threads[p], NULL, produce, (void *)(intptr_t)p));
+    }
+
+    while (count < PRODUCERS * PER_PRODUCER)
+    {
+        mpscq_node_t *n = mpscq_pop(&q);
+
+        if (!n)
+        {
+            /* As the router does: sleep only when nothing is in flight. */
+            if (mpscq_empty(&q))
+            {
+                sleep_for_wake();
+            }
+            continue;
+        }
+
+        item_t *it = (item_t *)n;
+
+        /* Each producer's items come out in the order pushed. */
+        assert(it->seq == next[it->producer]);
+        ++next[it->producer];
+        ++count;
+    }
+
+    for (p = 0; p < PRODUCERS; ++p)
+    {
+        pthread_join(threads[p], NULL);
+    }
+
+    assert(mpscq_empty(&q));
+}
+
+int
+main()
+{
+    test_single();
+    test_threads();
+
+    return 0;
+}
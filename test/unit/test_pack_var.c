@@ -0,0 +1,93 @@
+
+#include "libtrp.h"
+#include "../../src/pack.h"
+#include "../../src/util.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define MAXLEN (70000)
+
+static unsigned char in[MAXLEN];
+static unsigned char buf[MAXLEN + 16];
+
+/**
+ * 'b' is a byte count, the length most significant first, then the bytes.
+ */
+static void
+test_len(uint32_t len, size_t lenbytes)
+{
+    size_t n = trip_pack(sizeof(buf), buf, "Cb", 0xAB, len, in);
+    assert(1 + 1 + lenbytes + len == n);
+    assert(0xAB == buf[0]);
+    assert(lenbytes == buf[1]);
+
+    uint32_t wire = 0;
+    for (size_t i = 0; i < lenbytes; ++i)
+    {
+        wire = (wire << 8) | buf[2 + i];
+    }
+    assert(len == wire);
+
+    unsigned char c = 0;
+    uint32_t outlen = 0;
+    unsigned char *out = NULL;
+    assert(n == trip_unpack(n, buf, "Cb", &c, &outlen, &out));
+    assert(0xAB == c);
+    assert(len == outlen);
+    assert(!len || !memcmp(in, out, len));
+
+    /* Short by one, in the bytes or else in the length. */
+    assert(NPOS == trip_unpack(n - 1, buf, "Cb", &c, &outlen, &out));
+    if (lenbytes)
+    {
+        assert(NPOS == trip_unpack(1 + lenbytes, buf, "Cb", &c, &outlen, &out));
+    }
+}
+
+/**
+ * 'V' and 'W' are variable length, and round trip across their widths.
+ */
+static void
+test_uvar(uint64_t val)
+{
+    uint64_t w = 0;
+    uint32_t v = 0;
+    size_t n = trip_pack(sizeof(buf), buf, "WV", val, (uint32_t)val);
+    assert(NPOS != n);
+    assert(n == trip_unpack(n, buf, "WV", &w, &v));
+    assert(val == w);
+    assert((uint32_t)val == v);
+    assert(NPOS == trip_unpack(n - 1, buf, "WV", &w, &v));
+}
+
+int
+main()
+{
+    for (size_t i = 0; i < sizeof(in); ++i)
+    {
+        in[i] = (unsigned char)(i * 31 + 7);
+    }
+
+    test_len(0, 0);
+    test_len(5, 1);
+    test_len(255, 1);
+    test_len(300, 2);
+    test_len(0xFFFF, 2);
+    test_len(MAXLEN, 3);
+
+    test_uvar(0);
+    test_uvar(1);
+    test_uvar(255);
+    test_uvar(256);
+    test_uvar(0x123456789ABCULL);
+    test_uvar(~0ULL);
+
+    /* Too small to hold it. */
+    assert(NPOS == trip_pack(300, buf, "b", (uint32_t)300, in));
+
+    return 0;
+}
@@ -0,0 +1,55 @@
+
+#include "libtrp.h"
+#include "../../src/pmtu.h"
+
+#include <assert.h>
+
+
+#define BASE (1200)
+#define MAX (1500)
+
+/**
+ * Probes halve the gap, and a raised MTU falls back after a run of losses.
+ */
+static void
+test_blackhole(void)
+{
+    pmtu_t p;
+    pmtu_init(&p, BASE, MAX);
+    assert(BASE == pmtu_get(&p));
+    assert(!pmtu_raised(&p));
+
+    assert(1350 == pmtu_next(&p, 1, 100));
+    assert(pmtu_ack(&p, p.nonce));
+    assert(1350 == pmtu_get(&p));
+    assert(pmtu_raised(&p));
+
+    /* A delivery resets the run. */
+    for (int i = 0; i < _PMTU_BLACKHOLE - 1; ++i)
+    {
+        pmtu_loss(&p);
+    }
+    pmtu_delivered(&p);
+    for (int i = 0; i < _PMTU_BLACKHOLE - 1; ++i)
+    {
+        pmtu_loss(&p);
+    }
+    assert(1350 == pmtu_get(&p));
+
+    pmtu_loss(&p);
+    assert(BASE == pmtu_get(&p));
+    assert(!pmtu_raised(&p));
+    assert(1350 == p.fail);
+    assert(_PMTU_STATE_SEARCH == p.state);
+
+    /* The search resumes below the size that failed. */
+    assert(1275 == pmtu_next(&p, 2, 100));
+}
+
+int
+main()
+{
+    test_blackhole();
+
+    return 0;
+}
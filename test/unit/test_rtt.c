@@ -0,0 +1,105 @@
+
+#include "libtrp.h"
+#include "../../src/rtt.h"
+
+#include <assert.h>
+
+
+static void
+test_first_sample(void)
+{
+    rtt_t r;
+    rtt_init(&r, 100);
+    assert(100 == rtt_rto(&r));
+    assert(!r.sampled);
+
+    /* SRTT = R, RTTVAR = R/2, RTO = SRTT + 4 * RTTVAR */
+    rtt_sample(&r, 40, 0);
+    assert(r.sampled);
+    assert(40 == rtt_srtt(&r));
+    assert(40 + 4 * 20 == rtt_rto(&r));
+    assert(40 == r.minrtt);
+}
+
+static void
+test_smoothing(void)
+{
+    rtt_t r;
+    rtt_init(&r, 100);
+    rtt_sample(&r, 40, 0);
+
+    /* SRTT = 7/8 SRTT + 1/8 R, RTTVAR = 3/4 RTTVAR + 1/4 |SRTT - R| */
+    rtt_sample(&r, 80, 0);
+    assert(45 == rtt_srtt(&r));
+    assert(25 == r.rttvar4 / 4);
+    assert(45 + 100 == rtt_rto(&r));
+    assert(40 == r.minrtt);
+}
+
+static void
+test_delay(void)
+{
+    rtt_t r;
+    rtt_init(&r, 100);
+    rtt_sample(&r, 40, 0);
+
+    /* The time the peer held the PING is not path time. */
+    rtt_sample(&r, 50, 10);
+    assert(40 == rtt_srtt(&r));
+
+    /* Unless that would put it under the smallest seen; 45 is kept. */
+    rtt_sample(&r, 45, 10);
+    assert(8 * 40 - 40 + 45 == r.srtt8);
+    assert(40 == r.minrtt);
+}
+
+/**
+ * Karn: a resent PING gives no sample, so the backed off timeout holds
+ * until an unambiguous answer arrives.
+ */
+static void
+test_karn(void)
+{
+    rtt_t r;
+    rtt_init(&r, 100);
+    rtt_sample(&r, 20, 0);
+    uint32_t rto = rtt_rto(&r);
+
+    rtt_backoff(&r);
+    assert(2 * rto == rtt_rto(&r));
+    rtt_backoff(&r);
+    assert(4 * rto == rtt_rto(&r));
+
+    rtt_sample(&r, 20, 0);
+    assert(rtt_rto(&r) < 2 * rto);
+
+    int i;
+    for (i = 0; i < 32; ++i)
+    {
+        rtt_backoff(&r);
+    }
+    assert(_RTT_MAX_RTO == rtt_rto(&r));
+}
+
+static void
+test_clamp(void)
+{
+    rtt_t r;
+    rtt_init(&r, 0);
+    assert(_RTT_MIN_RTO == rtt_rto(&r));
+
+    rtt_sample(&r, 0, 0);
+    assert(_RTT_MIN_RTO == rtt_rto(&r));
+}
+
+int
+main()
+{
+    test_first_sample();
+    test_smoothing();
+    test_delay();
+    test_karn();
+    test_clamp();
+
+    return 0;
+}
@@ -0,0 +1,82 @@
+
+#include "libtrp.h"
+#include "../../src/rxpool.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+
+#define BUFLEN (1400)
+#define MAX (2)
+
+static void
+test_recycle(void)
+{
+    rxpool_t p;
+    rxpool_init(&p, BUFLEN, MAX);
+    assert(rxpool_cap(&p) >= BUFLEN);
+
+    unsigned char *a = rxpool_get(&p);
+    unsigned char *b = rxpool_get(&p);
+    unsigned char *c = rxpool_get(&p);
+    assert(a && b && c);
+    memset(a, 0xA5, rxpool_cap(&p));
+
+    /* Any pointer into the buffer finds its header. */
+    rxpool_ref(&p, a + 100);
+    rxpool_unref(&p, a + BUFLEN - 1);
+    assert(0 == p.size);
+
+    rxpool_unref(&p, a);
+    rxpool_unref(&p, b);
+    assert(2 == p.size);
+
+    /* Past the cap, freed instead of kept. */
+    rxpool_unref(&p, c);
+    assert(MAX == p.size);
+
+    /* Most recently released comes back first. */
+    assert(b == rxpool_get(&p));
+    assert(a == rxpool_get(&p));
+    assert(0 == p.size);
+
+    rxpool_unref(&p, a);
+    rxpool_unref(&p, b);
+    rxpool_destroy(&p);
+    assert(0 == p.size && NULL == p.free);
+}
+
+static void
+test_large(void)
+{
+    rxpool_t p;
+    rxpool_init(&p, BUFLEN, MAX);
+
+    /* Small enough for a pooled buffer. */
+    unsigned char *s = rxpool_get_large(&p, rxpool_cap(&p));
+    assert(s);
+    rxpool_unref(&p, s);
+    assert(1 == p.size);
+
+    /* Spans segments; never pooled. */
+    size_t len = 10 * BUFLEN;
+    unsigned char *l = rxpool_get_large(&p, len);
+    assert(l);
+    memset(l, 0x5A, len);
+    rxpool_ref(&p, l);
+    rxpool_unref(&p, l);
+    rxpool_unref(&p, l);
+    assert(1 == p.size);
+
+    rxpool_destroy(&p);
+}
+
+int
+main()
+{
+    test_recycle();
+    test_large();
+
+    return 0;
+}
@@ -0,0 +1,97 @@
+
+#include "libtrp.h"
+#include "../../src/streammap.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+
+
+#define STREAMS (4096)
+#define ROUNDS (300000)
+
+static _trip_stream_t streams[STREAMS];
+static bool used[STREAMS];
+
+/**
+ * Low IDs go in the dense array and high ones in the sparse block.
+ */
+static void
+test_random(void)
+{
+    streammap_t m;
+    streammap_init(&m);
+    srand(3);
+
+    for (int i = 0; i < STREAMS; ++i)
+    {
+        streams[i].id = i < STREAMS / 2 ? i : 100000 + (i * 7919) % 1000000;
+    }
+
+    for (int round = 0; round < ROUNDS; ++round)
+    {
+        int k = rand() % STREAMS;
+        _trip_stream_t *s = &streams[k];
+
+        if (!used[k])
+        {
+            assert(0 == streammap_add(&m, s));
+            assert(EEXIST == streammap_add(&m, s));
+            used[k] = true;
+        }
+        else
+        {
+            assert(s == streammap_del(&m, s->id));
+            assert(NULL == streammap_get(&m, s->id));
+            used[k] = false;
+        }
+    }
+
+    uint32_t n = 0;
+    for (int k = 0; k < STREAMS; ++k)
+    {
+        if (used[k])
+        {
+            assert(&streams[k] == streammap_get(&m, streams[k].id));
+            ++n;
+        }
+    }
+    assert(n == m.size);
+
+    /* Teardown empties it completely. */
+    _trip_stream_t *s;
+    while ((s = streammap_last(&m)))
+    {
+        assert(s == streammap_del(&m, s->id));
+        --n;
+    }
+    assert(0 == n && 0 == m.size && 0 == m.top && NULL == m.sparse);
+    assert(_STREAMMAP_MIN_CAP == m.cap);
+
+    streammap_destroy(&m);
+}
+
+static void
+test_invalid(void)
+{
+    streammap_t m;
+    streammap_init(&m);
+
+    _trip_stream_t s = { .id = -1 };
+    assert(ERANGE == streammap_add(&m, &s));
+    assert(NULL == streammap_get(&m, 5));
+    assert(NULL == streammap_del(&m, 5));
+    assert(NULL == streammap_del(&m, _STREAMMAP_DENSE_MAX + 5));
+    assert(NULL == streammap_last(&m));
+
+    streammap_destroy(&m);
+}
+
+int
+main()
+{
+    test_random();
+    test_invalid();
+
+    return 0;
+}
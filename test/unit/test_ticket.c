@@ -0,0 +1,125 @@
+
+#include "libtrp.h"
+#include "../../src/ticket.h"
+#include "../../src/util.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+
+
+#define LIFEMS (60000)
+
+static void
+test_replay(void)
+{
+    ticketreplay_t t;
+    ticketreplay_init(&t);
+
+    uint64_t issued = 10 * LIFEMS + 5;
+
+    /* Single use. */
+    assert(0 == ticketreplay_add(&t, 0x1234, issued, LIFEMS));
+    assert(EALREADY == ticketreplay_add(&t, 0x1234, issued, LIFEMS));
+    assert(0 == ticketreplay_add(&t, 0x5678, issued, LIFEMS));
+
+    /* A zero tag is still remembered. */
+    assert(0 == ticketreplay_add(&t, 0, issued, LIFEMS));
+    assert(EALREADY == ticketreplay_add(&t, 0, issued, LIFEMS));
+
+    /* The next epoch keeps the last, a ticket may still be valid from it. */
+    assert(0 == ticketreplay_add(&t, 0x9ABC, issued + LIFEMS, LIFEMS));
+    assert(EALREADY == ticketreplay_add(&t, 0x1234, issued, LIFEMS));
+
+    /* Two epochs on, the first is dropped whole... */
+    assert(0 == ticketreplay_add(&t, 0xDEF0, issued + 2 * LIFEMS, LIFEMS));
+    assert(EALREADY == ticketreplay_add(&t, 0x9ABC, issued + LIFEMS, LIFEMS));
+    /* ...and anything issued then is refused outright. */
+    assert(EALREADY == ticketreplay_add(&t, 0x4321, issued, LIFEMS));
+
+    /* Grows with the redeem rate rather than refusing once full. */
+    uint64_t tag;
+    for (tag = 1; tag <= 10 * _TICKET_REPLAY; ++tag)
+    {
+        assert(0 == ticketreplay_add(&t, tag << 20, issued + 2 * LIFEMS, LIFEMS));
+    }
+    for (tag = 1; tag <= 10 * _TICKET_REPLAY; ++tag)
+    {
+        assert(EALREADY == ticketreplay_add(&t, tag << 20, issued + 2 * LIFEMS, LIFEMS));
+    }
+
+    ticketreplay_destroy(&t);
+}
+
+static void
+test_seal(void)
+{
+    unsigned char key[_TICKET_KEY];
+    memset(key, 7, sizeof(key));
+
+    connrec_t rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.id = 42;
+    rec.peerid = 24;
+    rec.sequence = 1000;
+    memset(rec.ticketsecret, 3, sizeof(rec.ticketsecret));
+
+    unsigned char buf[1024];
+    size_t len = ticket_seal(key, 5000, &rec, sizeof(buf), buf);
+    assert(NPOS != len);
+    assert(ticket_len(&rec) == len);
+    assert(NPOS == ticket_seal(key, 5000, &rec, len - 1, buf));
+
+    connrec_t out;
+    uint64_t tag = 0;
+    uint64_t issued = 0;
+    assert(0 == ticket_open(key, 6000, LIFEMS, len, buf, &out, &tag, &issued));
+    assert(5000 == issued);
+    assert(42 == out.id && 24 == out.peerid && 1000 == out.sequence);
+    assert(!memcmp(out.ticketsecret, rec.ticketsecret, sizeof(rec.ticketsecret)));
+    connrec_clear(&out);
+
+    /* Expired, or from the future. */
+    assert(ETIME == ticket_open(key, 5000 + LIFEMS + 1, LIFEMS, len, buf, &out, &tag, &issued));
+    assert(ETIME == ticket_open(key, 4999, LIFEMS, len, buf, &out, &tag, &issued));
+
+    /* Forged. */
+    buf[crypto_secretbox_NONCEBYTES] ^= 1;
+    assert(EINVAL == ticket_open(key, 6000, LIFEMS, len, buf, &out, &tag, &issued));
+    assert(EINVAL == ticket_open(key, 6000, LIFEMS, _TICKET_OVERHEAD, buf, &out, &tag, &issued));
+}
+
+static void
+test_derive(void)
+{
+    unsigned char secret[_TICKET_SECRET];
+    unsigned char salt[_TRIP_NONCE];
+    memset(secret, 1, sizeof(secret));
+    memset(salt, 2, sizeof(salt));
+
+    ticketkeys_t a;
+    ticketkeys_t b;
+    ticket_derive(secret, salt, &a);
+    ticket_derive(secret, salt, &b);
+
+    /* Both ends derive the same keys from the same RESUME. */
+    assert(!memcmp(&a, &b, sizeof(a)));
+    assert(memcmp(a.sk[0], a.sk[1], TRIP_KEY_SEC));
+    assert(memcmp(a.nonce[0], a.nonce[1], _TRIP_NONCE));
+
+    /* A fresh salt gives fresh keys. */
+    salt[0] ^= 1;
+    ticket_derive(secret, salt, &b);
+    assert(memcmp(a.tag, b.tag, _TICKET_TAG));
+    assert(memcmp(a.sk[0], b.sk[0], TRIP_KEY_SEC));
+}
+
+int
+main()
+{
+    test_replay();
+    test_seal();
+    test_derive();
+
+    return 0;
+}